@@ -0,0 +1,218 @@
+/*
+ * banner_stage.h - Asynchronous banner reader for already-open probes
+ *
+ * Engines hand the connected probe socket of every open port to the
+ * BannerStage instead of closing it. A single thread sends the
+ * port-specific probe (see bannerProbe) and polls all pending sockets
+ * with a per-socket deadline, so at most `maxActive` banners are read at
+ * once and a slow service never holds up the connect sweep. submit()
+ * never blocks; instead engines stop starting connects while the backlog
+ * is full (BannerGate for event engines, waitForSpace() for the thread
+ * engine), so the sweep slows down to the pace the banners are read at
+ * without stalling a reactor that still has connects in flight.
+ */
+#pragma once
+
+#include "metrics.h"
+#include "scan_engine.h"
+#include "socket_manager.h"
+#include "transport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class BannerStage {
+public:
+  // Receives the raw bytes read (empty on timeout / no data)
+  using Callback = std::function<void(std::string)>;
+
+  // Sockets are closed through `sockets` when given (they came from it)
+  BannerStage(int maxActive, int timeoutMs, size_t maxQueued,
+              SocketManager *sockets = nullptr)
+      : maxActive_(std::max(1, maxActive)), timeoutMs_(timeoutMs),
+        maxQueued_(std::max<size_t>(1, maxQueued)), sockets_(sockets),
+        worker_([this] { loop(); }) {}
+
+  ~BannerStage() { finish(); }
+
+  // Optional: time spent queued for a slot, and reading (call before use)
+  void setMetrics(LatencyHistogram *queued, LatencyHistogram *read) {
+    queuedHist_ = queued;
+    readHist_ = read;
+  }
+
+  // Takes ownership of a connected socket without waiting; the backlog
+  // limit is enforced before connects start (see backlogged()), so it
+  // may be overshot by the connects that were already in flight. After
+  // finish() the socket is closed and the callback gets no banner.
+  void submit(net::socket_t sock, int port, Callback done) {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (!stopping_) {
+        queue_.push_back(Job{sock, port, std::move(done), {},
+                             std::chrono::steady_clock::now(), std::string()});
+        cond_.notify_one();
+        return;
+      }
+    }
+    release(sock);
+    done(std::string());
+  }
+
+  // True while no more open sockets should be produced
+  bool backlogged() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return !stopping_ && queue_.size() >= maxQueued_;
+  }
+
+  // Blocks until the backlog has room (thread engine, before a connect)
+  void waitForSpace() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    space_.wait(lock,
+                [this] { return stopping_ || queue_.size() < maxQueued_; });
+  }
+
+  // Complete every submitted banner, then stop the worker thread
+  void finish() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stopping_ = true;
+    }
+    cond_.notify_one();
+    space_.notify_all();
+    if (worker_.joinable())
+      worker_.join();
+  }
+
+private:
+  struct Job {
+    net::socket_t sock;
+    int port;
+    Callback done;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point since; // queued, then started
+    std::string data;
+  };
+
+  void loop() {
+    std::vector<Job> active;
+    std::vector<net::pollfd_t> pfds;
+
+    while (true) {
+      // ── Admit queued sockets up to the concurrency limit ──
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (active.empty())
+          cond_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (active.empty() && queue_.empty() && stopping_)
+          return;
+        bool admitted = false;
+        while (!queue_.empty() && (int)active.size() < maxActive_) {
+          active.push_back(std::move(queue_.front()));
+          queue_.pop_front();
+          start(active.back());
+          admitted = true;
+        }
+        if (admitted)
+          space_.notify_all();
+      }
+
+      // ── Wait for data (short slices so new work is admitted) ──
+      pfds.resize(active.size());
+      for (size_t i = 0; i < active.size(); i++) {
+        pfds[i].fd = active[i].sock;
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+      }
+      net::pollSockets(pfds.data(), pfds.size(), 10);
+
+      // ── Collect finished jobs ──
+      auto now = std::chrono::steady_clock::now();
+      size_t keep = 0;
+      for (size_t i = 0; i < active.size(); i++) {
+        Job &job = active[i];
+        bool done = now >= job.deadline;
+        if (pfds[i].revents & (POLLIN | POLLERR | POLLHUP)) {
+          char buf[512];
+          int n = net::recvData(job.sock, buf, sizeof(buf) - 1);
+          if (n > 0)
+            job.data.assign(buf, (size_t)n);
+          done = true;
+        }
+        if (done) {
+          if (readHist_)
+            readHist_->recordSince(job.since);
+          release(job.sock);
+          job.done(std::move(job.data));
+        } else {
+          if (keep != i)
+            active[keep] = std::move(job);
+          keep++;
+        }
+      }
+      active.resize(keep);
+    }
+  }
+
+  void start(Job &job) {
+    if (queuedHist_)
+      queuedHist_->recordSince(job.since);
+    job.since = std::chrono::steady_clock::now();
+    job.deadline = job.since + std::chrono::milliseconds(timeoutMs_);
+    net::setNonBlocking(job.sock, true);
+    if (const char *req = bannerProbe(job.port))
+      net::sendData(job.sock, req, (int)std::strlen(req));
+  }
+
+  void release(net::socket_t sock) {
+    if (sockets_)
+      sockets_->close(sock);
+    else
+      net::closeSocket(sock);
+  }
+
+  int maxActive_;
+  int timeoutMs_;
+  size_t maxQueued_;
+  SocketManager *sockets_;
+  LatencyHistogram *queuedHist_ = nullptr;
+  LatencyHistogram *readHist_ = nullptr;
+
+  mutable std::mutex mtx_;
+  std::condition_variable cond_;  // work for the reader
+  std::condition_variable space_; // room in the backlog
+  std::deque<Job> queue_;
+  bool stopping_ = false;
+  std::thread worker_;
+};
+
+// ─────────────────────────────────────────────
+//  Banner Backpressure for Event Engines
+// ─────────────────────────────────────────────
+// Throttle in front of another one that also refuses new connects while
+// the banner backlog is full. The engine retries on its next tick, so its
+// sink never waits and connects already in flight keep being polled.
+class BannerGate : public Throttle {
+public:
+  BannerGate(Throttle &inner, const BannerStage &banners)
+      : inner_(inner), banners_(banners) {}
+
+  bool tryAcquire(uint64_t &ticket) override {
+    return !banners_.backlogged() && inner_.tryAcquire(ticket);
+  }
+  void cancel(uint64_t ticket) override { inner_.cancel(ticket); }
+  void release(uint64_t ticket, const ProbeOutcome &out) override {
+    inner_.release(ticket, out);
+  }
+
+private:
+  Throttle &inner_;
+  const BannerStage &banners_;
+};
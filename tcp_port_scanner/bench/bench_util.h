@@ -0,0 +1,28 @@
+/*
+ * bench_util.h - Bits shared by the benchmark drivers in bench/
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <streambuf>
+#include <vector>
+
+// Discards everything written to it; swapped into std::cout so the
+// scanner's own console output does not end up in the measurements
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+// Nearest-rank percentile (p in 0..100); sorts v. 0 when v is empty.
+template <class T> T percentile(std::vector<T> &v, double p) {
+  if (v.empty())
+    return T();
+  std::sort(v.begin(), v.end());
+  size_t rank = (size_t)(p / 100.0 * (double)v.size() + 0.999999);
+  return v[std::min(v.size(), std::max<size_t>(rank, 1)) - 1];
+}
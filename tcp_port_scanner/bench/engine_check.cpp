@@ -0,0 +1,180 @@
+/*
+ * engine_check.cpp - Engine contract check under a tight socket budget
+ *
+ * Runs the epoll and io_uring engines over a loopback port range with
+ * RLIMIT_NOFILE lowered so that SocketManager::open() keeps running out
+ * of descriptors (sockets held by a "hog" are handed back one at a time).
+ * Every engine must still honour the ProbeSource / ProbeSink / Throttle
+ * contract: each probe reported exactly once, each ticket released or
+ * cancelled exactly once, no socket left open. One JSON object per
+ * engine:
+ *
+ *   {"engine":"uring","probes":20000,"duplicates":0,"missing":0,
+ *    "tickets_leaked":0,"tickets_doubled":0,"sockets_leaked":0,
+ *    "stalls":311,"ok":true}
+ *
+ * Exits 1 when any engine breaks the contract.
+ *
+ * Build: make bench
+ * Usage: bench/engine_check [--probes n] [--budget n]
+ */
+#define PORT_SCANNER_NO_MAIN
+#include "../port_scanner.cpp"
+
+#ifdef __linux__
+
+#include <sys/resource.h>
+
+namespace {
+
+// Hands out a ticket per admission and records how it came back
+class CountingThrottle : public Throttle {
+public:
+  explicit CountingThrottle(size_t maxTickets)
+      : state_(new std::atomic<uint8_t>[maxTickets]), max_(maxTickets) {
+    for (size_t i = 0; i < max_; i++)
+      state_[i] = 0;
+  }
+
+  bool tryAcquire(uint64_t &ticket) override {
+    ticket = next_.fetch_add(1);
+    return ticket < max_;
+  }
+  void cancel(uint64_t ticket) override { state_[ticket]++; }
+  void release(uint64_t ticket, const ProbeOutcome &) override {
+    state_[ticket]++;
+  }
+
+  // Issued tickets never returned / returned more than once
+  void tally(uint64_t &leaked, uint64_t &doubled) const {
+    leaked = doubled = 0;
+    uint64_t issued = std::min<uint64_t>(next_.load(), max_);
+    for (uint64_t i = 0; i < issued; i++) {
+      leaked += state_[i] == 0;
+      doubled += state_[i] > 1;
+    }
+  }
+
+private:
+  std::unique_ptr<std::atomic<uint8_t>[]> state_;
+  size_t max_;
+  std::atomic<uint64_t> next_{0};
+};
+
+bool check(const std::string &engine, int probes) {
+  SocketManager sockets;
+  net::Endpoint target;
+  net::makeEndpoint("127.0.0.1", 1, target);
+
+  // Leave the engine a handful of descriptors; the rest come back slowly
+  std::vector<net::socket_t> hog;
+  int err = 0;
+  for (long i = 0; i + 4 < sockets.budget(); i++) {
+    net::socket_t s = sockets.open(target, err);
+    if (s == net::kInvalidSocket)
+      break;
+    hog.push_back(s);
+  }
+  std::atomic<bool> stop(false);
+  std::thread giveBack([&] {
+    while (!stop && !hog.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      sockets.close(hog.back());
+      hog.pop_back();
+    }
+  });
+
+  std::unique_ptr<std::atomic<uint8_t>[]> reports(
+      new std::atomic<uint8_t>[(size_t)probes]);
+  for (int i = 0; i < probes; i++)
+    reports[i] = 0;
+  CountingThrottle throttle((size_t)probes * 2);
+  std::atomic<int> cursor(0);
+
+  ProbeSource source = [&](Probe &p) {
+    int i = cursor.fetch_add(1);
+    if (i >= probes)
+      return false;
+    p = Probe();
+    p.port = 20000 + i % 40000;
+    p.id = (uint64_t)i;
+    p.ep = target;
+    net::setEndpointPort(p.ep, p.port);
+    return true;
+  };
+  ProbeSink sink = [&](const Probe &p, const ProbeOutcome &) {
+    reports[p.id]++;
+  };
+
+  EngineOptions opts;
+  opts.timeoutMs = 500;
+  opts.reactors = 1;
+  opts.maxInFlight = 64;
+  opts.pinThreads = false;
+  opts.throttle = &throttle;
+  opts.sockets = &sockets;
+  bool ran = engine == "uring" ? UringEngine(opts).run(source, sink)
+                               : (EpollEngine(opts).run(source, sink), true);
+  stop = true;
+  giveBack.join();
+  for (net::socket_t s : hog)
+    sockets.close(s);
+
+  uint64_t duplicates = 0, missing = 0, leaked = 0, doubled = 0;
+  for (int i = 0; i < probes; i++) {
+    duplicates += reports[i] > 1;
+    missing += reports[i] == 0;
+  }
+  throttle.tally(leaked, doubled);
+  bool ok = ran && duplicates == 0 && missing == 0 && leaked == 0 &&
+            doubled == 0 && sockets.live() == 0;
+  std::cout << "{\"engine\":\"" << engine << "\",\"probes\":" << probes
+            << ",\"duplicates\":" << duplicates << ",\"missing\":" << missing
+            << ",\"tickets_leaked\":" << leaked
+            << ",\"tickets_doubled\":" << doubled
+            << ",\"sockets_leaked\":" << sockets.live()
+            << ",\"stalls\":" << sockets.stalls()
+            << ",\"ok\":" << (ok ? "true" : "false") << "}\n"
+            << std::flush;
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int probes = 20000;
+  int budget = 24;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool more = i + 1 < argc;
+    if (arg == "--probes" && more)
+      probes = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--budget" && more)
+      budget = std::max(8, std::stoi(argv[++i]));
+    else {
+      std::cerr << "unknown option: " << arg << "\n";
+      return 1;
+    }
+  }
+
+  // SocketManager reserves kReservedFds below the soft limit
+  rlimit rl;
+  getrlimit(RLIMIT_NOFILE, &rl);
+  rl.rlim_cur = (rlim_t)(budget + SocketManager::kReservedFds);
+  setrlimit(RLIMIT_NOFILE, &rl);
+  net::startup();
+
+  bool ok = check("epoll", probes);
+  if (UringEngine::available())
+    ok = check("uring", probes) && ok;
+  return ok ? 0 : 1;
+}
+
+#else
+
+int main() {
+  std::cerr << "engine_check needs Linux (epoll / io_uring)\n";
+  return 0;
+}
+
+#endif // __linux__
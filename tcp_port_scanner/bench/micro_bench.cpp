@@ -0,0 +1,222 @@
+/*
+ * micro_bench.cpp - Microbenchmarks for the scanner's CPU-side hot paths
+ *
+ * Times the per-probe work that does not touch the network: port spec
+ * parsing, banner sanitising and fingerprinting, service lookups, result
+ * recording and rendering the progress bar / result rows. Each benchmark
+ * runs a fixed batch several times and reports the fastest batch, one
+ * JSON object per line:
+ *
+ *   {"bench":"clean_banner","iters":200000,"ns_per_op":262.5,
+ *    "ops_per_sec":3809257}
+ *
+ * Build: make bench
+ * Usage: bench/micro_bench [--filter substring] [--reps n]
+ *                          [--fingerprints file]
+ */
+#define PORT_SCANNER_NO_MAIN
+#include "../port_scanner.cpp"
+
+#include "bench_util.h"
+
+namespace {
+
+volatile uint64_t g_sink; // keeps results observable to the optimiser
+
+struct Bench {
+  const char *name;
+  uint64_t iters;               // operations per batch
+  std::function<void()> batch; // runs `iters` operations
+};
+
+void report(const Bench &b, double bestNs) {
+  double perOp = bestNs / (double)b.iters;
+  std::cout << "{\"bench\":\"" << b.name << "\",\"iters\":" << b.iters
+            << ",\"ns_per_op\":" << std::fixed << std::setprecision(1) << perOp
+            << ",\"ops_per_sec\":" << (uint64_t)(1e9 / std::max(perOp, 1e-3))
+            << "}\n"
+            << std::flush;
+}
+
+double timeBatch(const Bench &b) {
+  auto start = std::chrono::steady_clock::now();
+  b.batch();
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// A mixed spec with singles, ranges, overlaps and whitespace, as a long
+// --ports list from a config file would look
+std::string mixedPortSpec() {
+  std::string spec;
+  for (int i = 0; i < 2000; i++) {
+    int p = 1 + (i * 7919) % 65000;
+    if (!spec.empty())
+      spec += i % 5 == 0 ? ", " : ",";
+    if (i % 3 == 0)
+      spec += std::to_string(p) + "-" + std::to_string(p + i % 200);
+    else
+      spec += std::to_string(p);
+  }
+  return spec;
+}
+
+const char *kBanners[] = {
+    "SSH-2.0-OpenSSH_8.9p1 Ubuntu-3ubuntu0.6\r\n",
+    "HTTP/1.0 200 OK\r\nServer: SimpleHTTP/0.6 Python/3.11.7\r\n"
+    "Date: Fri, 16 Oct 2026 10:00:00 GMT\r\nContent-type: text/html\r\n\r\n",
+    "220 mail.example.com ESMTP Postfix (Ubuntu)\r\n",
+    "+OK Dovecot (Ubuntu) ready.\r\n",
+    "\x16\x03\x01\x00\xa5\x01\x00\x00\xa1\x03\x03 binary junk \x00\xff",
+    "-ERR unknown command 'GET'\r\n",
+};
+const size_t kBannerCount = sizeof(kBanners) / sizeof(kBanners[0]);
+
+ScanResult openResult(int port, size_t i) {
+  ScanResult r = newResult(port);
+  r.open = true;
+  r.status = net::ConnectStatus::Open;
+  r.responseTimeMs = (long)(i % 50);
+  r.host = "10.0.0." + std::to_string(1 + i % 254);
+  r.banner = cleanBanner(kBanners[i % kBannerCount],
+                         std::strlen(kBanners[i % kBannerCount]));
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string filter, rulesFile;
+  int reps = 5;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool more = i + 1 < argc;
+    if (arg == "--filter" && more)
+      filter = argv[++i];
+    else if (arg == "--reps" && more)
+      reps = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--fingerprints" && more)
+      rulesFile = argv[++i];
+    else {
+      std::cerr << "unknown option: " << arg << "\n";
+      return 1;
+    }
+  }
+
+  std::string err;
+  if (loadServices("", argv[0], err).empty() ||
+      loadFingerprints(rulesFile, argv[0], err).empty())
+    std::cerr << "warning: " << (err.empty() ? "no fingerprint rules" : err)
+              << "\n";
+
+  ScanConfig cfg;
+  std::string targetErr;
+  cfg.targets.addSpec("10.0.0.0/24", resolveHost, targetErr);
+  g_multiHost = true;
+  g_totalProbes = 1000000;
+  g_plannedProbes = g_totalProbes;
+  g_keepResults = false;
+
+  const std::string portSpec = mixedPortSpec();
+  std::vector<std::string> rawBanners(kBanners, kBanners + kBannerCount);
+  std::vector<ScanResult> rows;
+  for (size_t i = 0; i < 64; i++)
+    rows.push_back(openResult(20 + (int)i, i));
+  const char *names[] = {"SSH", "http", "MySQL", "no-such-service"};
+
+  NullBuffer null;
+  std::ostream nullOut(&null);
+
+  std::vector<Bench> benches = {
+      {"parse_ports_mixed", 200,
+       [&] {
+         for (int i = 0; i < 200; i++)
+           g_sink += parsePorts(portSpec).toVector().size();
+       }},
+      {"parse_ports_full_range", 20000,
+       [&] {
+         for (int i = 0; i < 20000; i++)
+           g_sink += parsePorts("1-65535").toVector().size();
+       }},
+      {"clean_banner", 200000,
+       [&] {
+         for (int i = 0; i < 200000; i++) {
+           const std::string &b = rawBanners[(size_t)i % kBannerCount];
+           g_sink += cleanBanner(b.data(), b.size()).size();
+         }
+       }},
+      {"apply_banner", 100000,
+       [&] {
+         for (int i = 0; i < 100000; i++) {
+           ScanResult r = newResult(22);
+           applyBanner(r, rawBanners[(size_t)i % kBannerCount]);
+           g_sink += r.serviceId + r.product.size();
+         }
+       }},
+      {"service_lookup", 1000000,
+       [&] {
+         for (int i = 0; i < 1000000; i++)
+           g_sink += g_services.lookup(1 + i % 65535);
+       }},
+      {"service_name", 1000000,
+       [&] {
+         for (int i = 0; i < 1000000; i++)
+           g_sink += (uint64_t)(uintptr_t)g_services.name(
+               g_services.lookup(1 + i % 1024));
+       }},
+      {"service_find", 100000,
+       [&] {
+         for (int i = 0; i < 100000; i++)
+           g_sink += g_services.find(names[i % 4]);
+       }},
+      {"record_closed", 1000000,
+       [&] {
+         ScanResult r = newResult(80);
+         r.status = net::ConnectStatus::Refused;
+         for (int i = 0; i < 1000000; i++)
+           recordResult(cfg, (uint64_t)i % 256, r);
+       }},
+      {"record_open", 100000,
+       [&] {
+         // The reporter drains the queue as it would during a scan
+         std::streambuf *console = std::cout.rdbuf(&null);
+         g_reporter.start();
+         for (int i = 0; i < 100000; i++)
+           recordResult(cfg, (uint64_t)i % 256, rows[(size_t)i % rows.size()]);
+         g_reporter.stop();
+         std::cout.rdbuf(console);
+       }},
+      {"format_progress", 100000,
+       [&] {
+         for (int i = 0; i < 100000; i++) {
+           g_scanned.store((uint64_t)i * 10, std::memory_order_relaxed);
+           g_sink += formatProgress().size();
+         }
+       }},
+      {"format_open_port", 100000,
+       [&] {
+         for (int i = 0; i < 100000; i++)
+           formatOpenPort(nullOut, rows[(size_t)i % rows.size()]);
+       }},
+      {"format_closed_port", 100000,
+       [&] {
+         for (int i = 0; i < 100000; i++)
+           formatClosedPort(nullOut, rows[(size_t)i % rows.size()]);
+       }},
+  };
+
+  for (const Bench &b : benches) {
+    if (!filter.empty() && std::string(b.name).find(filter) == std::string::npos)
+      continue;
+    timeBatch(b); // warm-up
+    double best = 0;
+    for (int r = 0; r < reps; r++) {
+      double ns = timeBatch(b);
+      if (r == 0 || ns < best)
+        best = ns;
+    }
+    report(b, best);
+  }
+  return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * sim_bench.cpp - Scan pipeline benchmark against the simulated network
+ *
+ * Runs the scanner's own runScan() against SimNetwork, so generator,
+ * congestion control, RTT/retry logic, reporter and result store are all
+ * the production code; only the wire is replaced. --engine sim (default)
+ * drives it through SimEngine, --engine thread through the real thread
+ * engine (WorkStealingPool, connectTimed, banner stage), with the
+ * simulator as SocketManager's transport. Each run prints one JSON object:
+ *
+ *   {"run":1,"engine":"sim","probes":252190,"elapsed_ms":2614,
+ *    "cpu_ms":441,"probes_per_sec":96476,"open_expected":732,
+ *    "open_found":732,"false_negatives":0,"false_positives":0,
+ *    "filtered_expected":1220,"filtered_reported":1221,"hosts_skipped":12}
+ *
+ * probes counts the host discovery pings and retries too. Accuracy is
+ * measured against the profile's ground truth, so loss and too-short
+ * timeouts show up as false negatives. Hosts that discovery marked down
+ * are never port-scanned: they are counted in hosts_skipped rather than
+ * filtered_expected (an open port on one is still a false negative).
+ *
+ * Build: make bench
+ * Usage: bench/sim_bench [--hosts spec] [-p ports] [--sim profile]
+ *                        [--engine sim|thread] [-t n]
+ *                        [-T ms] [--inflight n] [--reactors n]
+ *                        [--retries n] [--max-rate pps] [--randomize]
+ *                        [--no-adaptive] [--runs n]
+ */
+#define PORT_SCANNER_NO_MAIN
+#include "../port_scanner.cpp"
+
+#include "bench_util.h"
+
+#include <unordered_set>
+
+namespace {
+
+const char *kDefaultProfile =
+    "open=22,80,443,8080;filtered=135-139;latency=normal:20:5;"
+    "loss=0.002;down=0.05;banner.22=SSH-2.0-OpenSSH_9.6\\r\\n;seed=1";
+
+struct Accuracy {
+  uint64_t openExpected = 0, openFound = 0;
+  uint64_t falseNegatives = 0, falsePositives = 0;
+  uint64_t filteredExpected = 0; // on hosts the port sweep covered
+  uint64_t hostsSkipped = 0;     // marked down by host discovery
+};
+
+Accuracy measure(const ScanConfig &cfg) {
+  Accuracy a;
+  std::unordered_set<uint64_t> found;
+  g_results.forEach([&](const ResultStore::View &v) {
+    if (v.state == ResultStore::kOpen)
+      found.insert(v.hostIdx * 65536 + (uint64_t)v.port);
+  });
+  a.openFound = found.size();
+
+  net::Endpoint ep;
+  for (uint64_t h = 0; h < cfg.targets.hostCount(); h++) {
+    cfg.targets.endpoint(h, ep);
+    bool skipped = g_hostsUp && !g_hostsUp->test(h);
+    if (skipped)
+      a.hostsSkipped++;
+    for (int port : cfg.ports) {
+      SimNetwork::State s = g_simNet.truth(ep, port);
+      bool isFound = found.count(h * 65536 + (uint64_t)port) != 0;
+      if (s == SimNetwork::State::Open) {
+        a.openExpected++;
+        if (!isFound)
+          a.falseNegatives++;
+      } else {
+        if (s == SimNetwork::State::Filtered && !skipped)
+          a.filteredExpected++;
+        if (isFound)
+          a.falsePositives++;
+      }
+    }
+  }
+  return a;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  ScanConfig cfg;
+  cfg.engine = "sim";
+  cfg.timeout = 500;
+  cfg.inFlight = 4096;
+  cfg.simProfile = kDefaultProfile;
+  std::string hosts = "10.0.0.0/24";
+  std::string portSpec = "1-1024";
+  int runs = 3;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool more = i + 1 < argc;
+    if (arg == "--hosts" && more)
+      hosts = argv[++i];
+    else if (arg == "-p" && more)
+      portSpec = argv[++i];
+    else if (arg == "--sim" && more)
+      cfg.simProfile = argv[++i];
+    else if (arg == "--engine" && more)
+      cfg.engine = argv[++i];
+    else if (arg == "-t" && more)
+      cfg.threads = std::max(1, std::min(500, std::stoi(argv[++i])));
+    else if (arg == "-T" && more)
+      cfg.timeout = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--inflight" && more)
+      cfg.inFlight = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--reactors" && more)
+      cfg.reactors = std::max(0, std::stoi(argv[++i]));
+    else if (arg == "--retries" && more)
+      cfg.retries = std::max(0, std::min(8, std::stoi(argv[++i])));
+    else if (arg == "--max-rate" && more)
+      cfg.maxRate = std::max(0.0, std::stod(argv[++i]));
+    else if (arg == "--randomize")
+      cfg.randomize = true;
+    else if (arg == "--no-adaptive")
+      cfg.adaptive = false;
+    else if (arg == "--runs" && more)
+      runs = std::max(1, std::stoi(argv[++i]));
+    else {
+      std::cerr << "unknown option: " << arg << "\n";
+      return 1;
+    }
+  }
+
+  std::string err;
+  if (!cfg.targets.addSpec(hosts, resolveHost, err)) {
+    std::cerr << "bad --hosts item: " << err << "\n";
+    return 1;
+  }
+  cfg.target = hosts;
+  cfg.ports = parsePorts(portSpec).toVector();
+  if (cfg.ports.empty() || !g_simNet.configure(cfg.simProfile, err)) {
+    std::cerr << "bad -p or --sim item: " << err << "\n";
+    return 1;
+  }
+  if (cfg.engine != "sim" && cfg.engine != "thread") {
+    std::cerr << "--engine must be sim or thread\n";
+    return 1;
+  }
+  g_sockets.setTransport(&g_simNet);
+  g_services.loadEntries(BUILTIN_SERVICES);
+  g_keepResults = true;
+
+  NullBuffer null;
+  for (int run = 1; run <= runs; run++) {
+    cfg.seed = (uint64_t)run;
+    g_simNet.resetAttempts();
+
+    std::streambuf *console = std::cout.rdbuf(&null);
+    auto start = std::chrono::steady_clock::now();
+    long long cpuStart = net::processCpuMs();
+    runScan(cfg);
+    long long cpuMs = net::processCpuMs() - cpuStart;
+    long long elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    std::cout.rdbuf(console);
+
+    uint64_t probes = g_scanned.load() + g_retried + g_pinged.load();
+    Accuracy a = measure(cfg);
+    std::cout << "{\"run\":" << run << ",\"engine\":\"" << cfg.engine << "\""
+              << ",\"probes\":" << probes << ",\"elapsed_ms\":" << elapsedMs
+              << ",\"cpu_ms\":" << cpuMs << ",\"probes_per_sec\":"
+              << (uint64_t)(probes * 1000.0 / std::max(1LL, elapsedMs))
+              << ",\"open_expected\":" << a.openExpected
+              << ",\"open_found\":" << a.openFound
+              << ",\"false_negatives\":" << a.falseNegatives
+              << ",\"false_positives\":" << a.falsePositives
+              << ",\"filtered_expected\":" << a.filteredExpected
+              << ",\"filtered_reported\":" << g_filteredCount.load()
+              << ",\"hosts_skipped\":" << a.hostsSkipped << "}\n"
+              << std::flush;
+  }
+  return 0;
+}
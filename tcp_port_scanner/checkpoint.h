@@ -0,0 +1,325 @@
+/*
+ * checkpoint.h - Periodic scan checkpoints for --resume
+ *
+ * A checkpoint is the set of probe indices that reached a final result,
+ * the open ports found so far, and enough of the configuration to refuse
+ * a resume against a different job:
+ *
+ *   Header   magic "PSCKPT03", config hash, seed, probe span,
+ *            filtered count, open record count,
+ *            u32 shard index, u32 shard count, u64 host count (0 when
+ *            every host was scanned), u64 port count
+ *   uint64_t done[(span + 63) / 64]   one bit per probe index
+ *   uint64_t up[(hosts + 63) / 64]    hosts found up by host discovery
+ *   uint16_t ports[port count]        the port order the bits follow
+ *   records  u64 host, u16 port, u16 service ID, u32 latency,
+ *            u16 len + banner, u16 len + version
+ *
+ * Bits index the unshuffled probe space, so the same file works whatever
+ * order the probes are visited in. The config hash covers the port set,
+ * not its order: a run whose services database orders the ports
+ * differently (--port-order freq) maps the bits onto its own order. The
+ * shard and the host mask tell --merge which probes the run was
+ * responsible for. "PSCKPT01" (no shard, no mask) and "PSCKPT02" files
+ * (no port list) are still read when their port order matches. The file
+ * is written to <path>.tmp and renamed over the old one, so a crash
+ * mid-write leaves the previous checkpoint intact.
+ *
+ * Threading: markDone() may be called from any thread. Everything else,
+ * including the open-result store, belongs to the reporter thread, which
+ * marks posted results itself after taking them off its queue; a saved
+ * bit therefore never refers to a result that is still in flight. The
+ * filtered count moves with the done bits and save() copies both under
+ * one lock, so a file never counts a probe its bitmap does not hold.
+ */
+#pragma once
+
+#include "result_store.h"
+#include "targets.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+class Checkpoint {
+public:
+  // configHash covers the port set, orderedHash also the order of ports
+  // (what PSCKPT01/02 files were stamped with)
+  Checkpoint(const std::string &path, uint64_t hosts,
+             const std::vector<int> &ports, uint64_t configHash,
+             uint64_t orderedHash)
+      : path_(path), hash_(configHash), orderedHash_(orderedHash),
+        ports_(ports), done_(hosts * ports.size()) {}
+
+  const std::string &path() const { return path_; }
+
+  uint64_t seed() const { return seed_; }
+  void setSeed(uint64_t seed) { seed_ = seed; }
+
+  // Any thread; filtered when the probe's final state is filtered
+  void markDone(uint64_t probeId, bool filtered) {
+    std::shared_lock<std::shared_mutex> lock(snapshotMtx_);
+    done_.set(probeId);
+    if (filtered)
+      filtered_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const Shard &shard() const { return shard_; }
+  void setShard(const Shard &shard) { shard_ = shard; }
+
+  // Hosts found up by host discovery; null when every host was scanned.
+  // Set before the reporter starts saving.
+  const ProbeSet *hostsUp() const { return hostsUp_.get(); }
+  void setHostsUp(const ProbeSet *up) {
+    hostsUp_.reset(up ? new ProbeSet(up->size()) : nullptr);
+    for (size_t w = 0; up && w < up->wordCount(); w++)
+      hostsUp_->setWord(w, up->word(w));
+  }
+
+  const ProbeSet &done() const { return done_; }
+  ResultStore &open() { return open_; }
+  uint64_t filtered() const { return filtered_.load(); }
+
+  bool save(std::string &err) const {
+    // Workers keep marking probes while the file is written: copy the
+    // bits and the filtered count at one instant
+    std::vector<uint64_t> done(done_.wordCount());
+    uint64_t filtered;
+    {
+      std::unique_lock<std::shared_mutex> lock(snapshotMtx_);
+      for (size_t w = 0; w < done.size(); w++)
+        done[w] = done_.word(w);
+      filtered = filtered_.load(std::memory_order_relaxed);
+    }
+
+    std::string tmp = path_ + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      if (!out.is_open()) {
+        err = "cannot write " + tmp;
+        return false;
+      }
+      Header h;
+      std::memcpy(h.magic, kMagic, 8);
+      h.configHash = hash_;
+      h.seed = seed_;
+      h.span = done_.size();
+      h.filtered = filtered;
+      h.openCount = open_.count(ResultStore::kOpen);
+      h.shardIndex = shard_.index;
+      h.shardCount = shard_.count;
+      h.hosts = hostsUp_ ? hostsUp_->size() : 0;
+      h.ports = ports_.size();
+      out.write((const char *)&h, sizeof(h));
+
+      out.write((const char *)done.data(),
+                (std::streamsize)(done.size() * sizeof(uint64_t)));
+      if (const ProbeSet *up = hostsUp()) {
+        std::vector<uint64_t> words(up->wordCount());
+        for (size_t w = 0; w < words.size(); w++)
+          words[w] = up->word(w);
+        out.write((const char *)words.data(),
+                  (std::streamsize)(words.size() * sizeof(uint64_t)));
+      }
+      for (int port : ports_)
+        put(out, (uint16_t)port);
+
+      open_.forEach([&](const ResultStore::View &v) {
+        if (v.state != ResultStore::kOpen)
+          return;
+        put(out, v.hostIdx);
+        put(out, (uint16_t)v.port);
+        put(out, v.serviceId);
+        put(out, v.latencyMs);
+        putString(out, v.banner);
+        putString(out, v.product);
+      });
+      if (!out) {
+        err = "write failed: " + tmp;
+        return false;
+      }
+    }
+    std::remove(path_.c_str()); // rename() does not replace on Windows
+    if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+      err = "cannot rename " + tmp;
+      return false;
+    }
+    return true;
+  }
+
+  // Replace the current state with the file's; fails when it was written
+  // for a different scan
+  bool load(const std::string &path, std::string &err) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+      err = "cannot open " + path;
+      return false;
+    }
+    // Version 1 headers stop before the shard fields, version 2 ones
+    // before the port count
+    Header h;
+    const size_t v1Size = offsetof(Header, shardIndex);
+    const size_t v2Size = offsetof(Header, ports);
+    int version = 0;
+    if (in.read((char *)&h, v1Size))
+      version = std::memcmp(h.magic, kMagicV1, 8) == 0   ? 1
+                : std::memcmp(h.magic, kMagicV2, 8) == 0 ? 2
+                : std::memcmp(h.magic, kMagic, 8) == 0   ? 3
+                                                         : 0;
+    size_t size = version == 1 ? v1Size : version == 2 ? v2Size : sizeof(h);
+    if (version >= 2 &&
+        !in.read((char *)&h + v1Size, (std::streamsize)(size - v1Size)))
+      version = 0;
+    if (version == 1) {
+      h.shardIndex = h.hosts = 0;
+      h.shardCount = 1;
+    }
+    if (version < 3)
+      h.ports = ports_.size();
+    if (version == 0 ||
+        h.shardIndex >= std::max<uint32_t>(h.shardCount, 1)) {
+      err = path + " is not a checkpoint file";
+      return false;
+    }
+    if (h.configHash != (version < 3 ? orderedHash_ : hash_) ||
+        h.span != done_.size() || h.hosts > h.span ||
+        h.ports != ports_.size()) {
+      err = path + " was written for a different target/port set";
+      return false;
+    }
+
+    std::vector<uint64_t> words(done_.wordCount());
+    in.read((char *)words.data(),
+            (std::streamsize)(words.size() * sizeof(uint64_t)));
+    std::unique_ptr<ProbeSet> up;
+    if (h.hosts > 0) {
+      up.reset(new ProbeSet(h.hosts));
+      std::vector<uint64_t> upWords(up->wordCount());
+      in.read((char *)upWords.data(),
+              (std::streamsize)(upWords.size() * sizeof(uint64_t)));
+      for (size_t w = 0; w < upWords.size(); w++)
+        up->setWord(w, upWords[w]);
+    }
+    std::vector<int> order = ports_;
+    for (size_t i = 0; version >= 3 && i < order.size(); i++) {
+      uint16_t port = 0;
+      get(in, port);
+      order[i] = port;
+    }
+    open_.clear();
+    for (uint64_t i = 0; in && i < h.openCount; i++) {
+      uint64_t host = 0;
+      uint16_t port = 0, serviceId = 0;
+      uint32_t latency = 0;
+      std::string banner, product;
+      get(in, host);
+      get(in, port);
+      get(in, serviceId);
+      get(in, latency);
+      getString(in, banner);
+      getString(in, product);
+      open_.add(host, port, ResultStore::kOpen, latency, serviceId, banner,
+                product);
+    }
+    if (!in) {
+      err = path + " is truncated";
+      return false;
+    }
+    if (!restoreDone(words, order)) {
+      err = path + " was written for a different target/port set";
+      return false;
+    }
+    seed_ = h.seed;
+    filtered_ = h.filtered;
+    shard_.index = h.shardIndex;
+    shard_.count = std::max<uint32_t>(h.shardCount, 1);
+    hostsUp_ = std::move(up);
+    return true;
+  }
+
+private:
+  // Done bits of a file whose ports came in `order` (the same set as
+  // ports_), moved to where ports_ puts each port
+  bool restoreDone(const std::vector<uint64_t> &words,
+                   const std::vector<int> &order) {
+    if (order == ports_) {
+      for (size_t w = 0; w < words.size(); w++)
+        done_.setWord(w, words[w]);
+      return true;
+    }
+    std::vector<int64_t> newIdx(65536, -1);
+    for (size_t i = 0; i < ports_.size(); i++)
+      newIdx[(size_t)ports_[i]] = (int64_t)i;
+    std::vector<uint64_t> moved(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      if (order[i] < 0 || order[i] > 65535 || newIdx[(size_t)order[i]] < 0)
+        return false;
+      moved[i] = (uint64_t)newIdx[(size_t)order[i]];
+    }
+    uint64_t hosts = done_.size() / ports_.size();
+    for (size_t w = 0; w < words.size(); w++) {
+      uint64_t bits = words[w];
+      while (bits) {
+        uint64_t i = w * 64 + (uint64_t)__builtin_ctzll(bits);
+        bits &= bits - 1;
+        if (i < done_.size())
+          done_.set(moved[i / hosts] * hosts + i % hosts);
+      }
+    }
+    return true;
+  }
+
+  struct Header {
+    char magic[8];
+    uint64_t configHash;
+    uint64_t seed;
+    uint64_t span;
+    uint64_t filtered;
+    uint64_t openCount;
+    uint32_t shardIndex;
+    uint32_t shardCount;
+    uint64_t hosts;
+    uint64_t ports;
+  };
+  static constexpr const char *kMagic = "PSCKPT03";
+  static constexpr const char *kMagicV2 = "PSCKPT02";
+  static constexpr const char *kMagicV1 = "PSCKPT01";
+
+  template <class T> static void put(std::ostream &out, T v) {
+    out.write((const char *)&v, sizeof(v));
+  }
+  template <class T> static void get(std::istream &in, T &v) {
+    in.read((char *)&v, sizeof(v));
+  }
+  static void putString(std::ostream &out, const char *s) {
+    uint16_t n = (uint16_t)std::min<size_t>(std::strlen(s), 0xFFFF);
+    put(out, n);
+    out.write(s, n);
+  }
+  static void getString(std::istream &in, std::string &s) {
+    uint16_t n = 0;
+    get(in, n);
+    s.resize(n);
+    if (n)
+      in.read(&s[0], n);
+  }
+
+  std::string path_;
+  uint64_t hash_, orderedHash_;
+  std::vector<int> ports_;
+  uint64_t seed_ = 0;
+  Shard shard_;
+  std::unique_ptr<ProbeSet> hostsUp_;
+  ProbeSet done_;
+  ResultStore open_;
+  std::atomic<uint64_t> filtered_{0};
+  mutable std::shared_mutex snapshotMtx_; // markDone() shared, save() alone
+};
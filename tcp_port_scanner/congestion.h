@@ -0,0 +1,205 @@
+/*
+ * congestion.h - Adaptive (AIMD) control of connects in flight
+ *
+ * The controller keeps a congestion window: the number of connects that
+ * may be outstanding at once. Probes are grouped by send order into
+ * epochs of roughly one window, and an epoch is judged once all of its
+ * probes have completed. A clean epoch grows the window (doubling during
+ * slow start, then a fixed additive step); an epoch whose timeout
+ * fraction spikes above the learned baseline halves it. Comparing against
+ * a baseline rather than zero keeps filtered hosts, where every probe
+ * times out by design, from being mistaken for a congested path.
+ *
+ * Optional rate bounds (probes/second):
+ *   maxRate - token-bucket pacing of new connects
+ *   minRate - the window never shrinks below minRate x average probe
+ *             duration (Little's law), so the scan keeps that pace
+ */
+#pragma once
+
+#include "scan_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+class CongestionController : public Throttle {
+public:
+  struct Options {
+    double initialWindow = 16;
+    double maxWindow = 4096; // engine capacity (threads / in-flight slots)
+    double minRate = 0;      // probes/s, 0 = no floor
+    double maxRate = 0;      // probes/s, 0 = unpaced
+    bool adaptive = true;    // false: fixed window, pacing only
+    int warmupMs = 0;        // learn the baseline for this long (timeout)
+  };
+
+  explicit CongestionController(const Options &opts)
+      : opts_(opts),
+        cwnd_(opts.adaptive ? std::min(opts.initialWindow, opts.maxWindow)
+                            : opts.maxWindow),
+        ssthresh_(opts.maxWindow), avgHoldMs_(0),
+        lastRefill_(std::chrono::steady_clock::now()),
+        warmupEnd_(lastRefill_ + std::chrono::milliseconds(opts.warmupMs)) {
+    tokens_ = burst();
+  }
+
+  bool tryAcquire(uint64_t &ticket) override {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return admitLocked(ticket);
+  }
+
+  // Blocking variant for the thread engine
+  uint64_t acquire() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    uint64_t ticket;
+    while (!admitLocked(ticket)) {
+      // Pacing tokens refill with time, window slots on release()
+      cond_.wait_for(lock, std::chrono::milliseconds(5));
+    }
+    return ticket;
+  }
+
+  void cancel(uint64_t ticket) override {
+    std::lock_guard<std::mutex> lock(mtx_);
+    inFlight_--;
+    epochs_[(size_t)(ticket - firstEpoch_)].sent--;
+    if (opts_.maxRate > 0)
+      tokens_ = std::min(burst(), tokens_ + 1);
+    cond_.notify_one();
+  }
+
+  void release(uint64_t ticket, const ProbeOutcome &out) override {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      inFlight_--;
+      Epoch &e = epochs_[(size_t)(ticket - firstEpoch_)];
+      e.done++;
+      if (out.status == net::ConnectStatus::TimedOut)
+        e.timeouts++;
+      if (out.elapsedMs >= 0)
+        avgHoldMs_ = avgHoldMs_ == 0
+                         ? (double)out.elapsedMs
+                         : avgHoldMs_ + 0.05 * ((double)out.elapsedMs - avgHoldMs_);
+
+      // Judge epochs in send order once all of their probes are back
+      while (!epochs_.empty() && epochs_.front().closed &&
+             epochs_.front().done == epochs_.front().sent) {
+        if (opts_.adaptive && epochs_.front().sent > 0)
+          endEpochLocked(epochs_.front());
+        epochs_.pop_front();
+        firstEpoch_++;
+      }
+    }
+    cond_.notify_all();
+  }
+
+  double window() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return cwnd_;
+  }
+
+  uint64_t backoffs() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return backoffs_;
+  }
+
+private:
+  // Probes grouped by when they were sent. Grouping by send time rather
+  // than completion time keeps each epoch a fair sample: refusals come
+  // back within an RTT while timeouts arrive a full timeout later.
+  struct Epoch {
+    uint32_t sent = 0, done = 0, timeouts = 0;
+    bool closed = false;
+  };
+
+  double burst() const { return std::max(1.0, opts_.maxRate / 100.0); }
+
+  double floorWindow() const {
+    double floor = 1;
+    if (opts_.minRate > 0 && avgHoldMs_ > 0)
+      floor = std::max(floor, opts_.minRate * avgHoldMs_ / 1000.0);
+    return std::min(floor, opts_.maxWindow);
+  }
+
+  bool admitLocked(uint64_t &ticket) {
+    if (inFlight_ >= (int)cwnd_)
+      return false;
+    if (opts_.maxRate > 0) {
+      auto now = std::chrono::steady_clock::now();
+      double secs = std::chrono::duration<double>(now - lastRefill_).count();
+      lastRefill_ = now;
+      tokens_ = std::min(burst(), tokens_ + secs * opts_.maxRate);
+      if (tokens_ < 1)
+        return false;
+      tokens_ -= 1;
+    }
+    inFlight_++;
+
+    if (epochs_.empty() || epochs_.back().closed)
+      epochs_.emplace_back();
+    Epoch &e = epochs_.back();
+    e.sent++;
+    if ((int)e.sent >= std::max(16, (int)cwnd_))
+      e.closed = true;
+    ticket = firstEpoch_ + epochs_.size() - 1;
+    return true;
+  }
+
+  void endEpochLocked(const Epoch &e) {
+    double frac = (double)e.timeouts / e.sent;
+    sinceCut_ += e.sent;
+    judged_++;
+
+    if (judged_ <= kWarmupEpochs ||
+        std::chrono::steady_clock::now() < warmupEnd_) {
+      // Until the first full timeouts are back, epochs are skewed by
+      // whichever probes answered first; average them instead of judging
+      baseline_ += (frac - baseline_) / judged_;
+    } else if (frac > baseline_ * 1.5 + 0.05) {
+      // Timeout spike: multiplicative decrease, at most once per window
+      // (epochs sent before the cut are already in flight). A level that
+      // persists becomes the new baseline after a few cuts.
+      baseline_ += 0.25 * (frac - baseline_);
+      if (sinceCut_ < cwnd_)
+        return;
+      ssthresh_ = std::max(floorWindow(), cwnd_ / 2);
+      cwnd_ = ssthresh_;
+      backoffs_++;
+      sinceCut_ = 0;
+      return;
+    } else {
+      baseline_ += 0.25 * (frac - baseline_);
+    }
+
+    // Clean epoch: slow start doubles, congestion avoidance adds a step
+    if (cwnd_ < ssthresh_)
+      cwnd_ = std::min(cwnd_ * 2, ssthresh_);
+    else
+      cwnd_ += std::max(1.0, opts_.maxWindow / 100.0);
+    cwnd_ = std::max(floorWindow(), std::min(cwnd_, opts_.maxWindow));
+  }
+
+  Options opts_;
+  mutable std::mutex mtx_;
+  std::condition_variable cond_;
+
+  double cwnd_;
+  double ssthresh_;
+  int inFlight_ = 0;
+
+  std::deque<Epoch> epochs_;
+  uint64_t firstEpoch_ = 0; // ticket of epochs_.front()
+  double sinceCut_ = 1e18;  // probes judged since the last decrease
+  static constexpr int kWarmupEpochs = 4;
+  int judged_ = 0;          // epochs judged so far
+  double baseline_ = 0;     // typical timeout fraction of this target set
+  double avgHoldMs_;        // EWMA of probe duration (for the min-rate floor)
+  uint64_t backoffs_ = 0;
+
+  double tokens_ = 0;
+  std::chrono::steady_clock::time_point lastRefill_;
+  std::chrono::steady_clock::time_point warmupEnd_;
+};
@@ -0,0 +1,482 @@
+/*
+ * dns_resolver.h - Concurrent hostname resolution with a TTL cache
+ *
+ * Resolving a target list one getaddrinfo() at a time serialises
+ * startup on round trips. AsyncResolver instead asks the configured
+ * nameservers directly over UDP with up to `maxInFlight` queries
+ * outstanding on one socket per server, an A and an AAAA query per
+ * name. Answers are matched by random query ID. Every A/AAAA record is
+ * kept (CNAME chains are followed by the server), with the smallest TTL
+ * of the set.
+ *
+ * Order of sources per name:
+ *   1. the hosts file (/etc/hosts or --hosts-file); never expires
+ *   2. the in-memory cache, optionally loaded from / saved to a file
+ *      (--dns-cache), honouring each entry's TTL
+ *   3. DNS over UDP to the servers from /etc/resolv.conf (or
+ *      --dns-server ip[:port])
+ *   4. getaddrinfo() for whatever DNS could not answer (no server,
+ *      truncated reply, search domains, NXDOMAIN), on a few threads
+ *
+ * Cache file: one line per name, "name expires-unix-time addr...".
+ */
+#pragma once
+
+#include "transport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class AsyncResolver {
+public:
+  struct Options {
+    std::vector<std::string> servers; // "ip" or "ip:port"; empty = resolv.conf
+    std::string hostsFile = "/etc/hosts"; // "" = none
+    int maxInFlight = 64;
+    int timeoutMs = 1000; // per attempt
+    int attempts = 3;     // rotating over the servers
+    bool ipv6 = true;     // also ask for AAAA
+  };
+
+  struct Stats {
+    size_t names = 0, hosts = 0, cached = 0, dns = 0, system = 0,
+           failed = 0;
+  };
+
+  explicit AsyncResolver(const Options &opts) : opts_(opts) {}
+
+  // Cached answers not yet expired; a missing file is not an error
+  bool loadCache(const std::string &path, std::string &err) {
+    std::ifstream in(path);
+    if (!in.is_open())
+      return true;
+    std::string line;
+    time_t now = std::time(nullptr);
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+      lineNo++;
+      if (line.empty() || line[0] == '#')
+        continue;
+      std::istringstream ss(line);
+      Entry e;
+      std::string name;
+      long long expires = 0;
+      if (!(ss >> name >> expires)) {
+        err = path + ":" + std::to_string(lineNo) + ": bad cache line";
+        return false;
+      }
+      e.expires = (time_t)expires;
+      std::string addr;
+      while (ss >> addr)
+        e.addrs.push_back(addr);
+      if (e.expires > now && !e.addrs.empty())
+        cache_[lower(name)] = e;
+    }
+    return true;
+  }
+
+  // Writes every unexpired entry (loaded or newly resolved)
+  bool saveCache(const std::string &path, std::string &err) const {
+    std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::trunc);
+      if (!out.is_open()) {
+        err = "cannot write " + tmp;
+        return false;
+      }
+      out << "# port_scanner DNS cache: name expires-unix-time addr...\n";
+      time_t now = std::time(nullptr);
+      for (const auto &kv : cache_) {
+        if (kv.second.expires <= now)
+          continue;
+        out << kv.first << " " << (long long)kv.second.expires;
+        for (const std::string &a : kv.second.addrs)
+          out << " " << a;
+        out << "\n";
+      }
+    }
+    std::remove(path.c_str()); // rename() does not replace on Windows
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      err = "cannot rename " + tmp;
+      return false;
+    }
+    return true;
+  }
+
+  // Resolve every name (duplicates are fine); blocks until all are done
+  void resolve(const std::vector<std::string> &names) {
+    loadHosts();
+    std::vector<std::string> pending;
+    time_t now = std::time(nullptr);
+    for (const std::string &raw : names) {
+      std::string name = lower(raw);
+      if (results_.count(name))
+        continue;
+      stats_.names++;
+      auto h = hosts_.find(name);
+      if (h != hosts_.end()) {
+        results_[name] = h->second;
+        stats_.hosts++;
+        continue;
+      }
+      auto c = cache_.find(name);
+      if (c != cache_.end() && c->second.expires > now) {
+        results_[name] = c->second.addrs;
+        stats_.cached++;
+        continue;
+      }
+      results_[name]; // placeholder, filled below
+      pending.push_back(name);
+    }
+
+    std::vector<std::string> unresolved = queryDns(pending);
+    resolveSystem(unresolved);
+  }
+
+  // Addresses for a resolved name (empty when it did not resolve)
+  const std::vector<std::string> &find(const std::string &name) const {
+    static const std::vector<std::string> none;
+    auto it = results_.find(lower(name));
+    return it == results_.end() ? none : it->second;
+  }
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  static constexpr uint32_t kSystemTtl = 300; // getaddrinfo has no TTL
+
+  struct Entry {
+    std::vector<std::string> addrs;
+    time_t expires = 0;
+  };
+
+  // One question on the wire
+  struct Query {
+    size_t name; // index into the pending list
+    uint16_t type;
+    int attempt;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  // Per-name progress over its A and AAAA questions
+  struct Answer {
+    std::vector<std::string> addrs;
+    uint32_t ttl = 0xFFFFFFFFu;
+    int outstanding = 0;
+    bool failed = false; // truncated / server error: ask the system
+  };
+
+  static std::string lower(std::string s) {
+    for (char &c : s)
+      c = (char)std::tolower((unsigned char)c);
+    if (!s.empty() && s.back() == '.')
+      s.pop_back();
+    return s;
+  }
+
+  void loadHosts() {
+    if (opts_.hostsFile.empty() || hostsLoaded_)
+      return;
+    hostsLoaded_ = true;
+    std::ifstream in(opts_.hostsFile);
+    std::string line;
+    while (std::getline(in, line)) {
+      size_t hash = line.find('#');
+      if (hash != std::string::npos)
+        line.erase(hash);
+      std::istringstream ss(line);
+      std::string addr, name;
+      net::Endpoint ep;
+      if (!(ss >> addr) || !net::makeEndpoint(addr, 0, ep))
+        continue;
+      if (ep.family() == AF_INET6 && !opts_.ipv6)
+        continue;
+      while (ss >> name) {
+        auto &list = hosts_[lower(name)];
+        if (std::find(list.begin(), list.end(), addr) == list.end())
+          list.push_back(addr);
+      }
+    }
+  }
+
+  // Servers from options, else the nameserver lines of resolv.conf
+  std::vector<net::Endpoint> servers() const {
+    std::vector<std::string> specs = opts_.servers;
+    if (specs.empty()) {
+      std::ifstream in("/etc/resolv.conf");
+      std::string line;
+      while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string key, addr;
+        if (ss >> key >> addr && key == "nameserver")
+          specs.push_back(addr);
+      }
+    }
+    std::vector<net::Endpoint> out;
+    for (const std::string &spec : specs) {
+      std::string host = spec;
+      int port = 53;
+      // "ip:port" for IPv4, "[ip]:port" for IPv6
+      size_t close = spec.find(']');
+      size_t colon = spec.rfind(':');
+      if (spec[0] == '[' && close != std::string::npos) {
+        host = spec.substr(1, close - 1);
+        if (close + 1 < spec.size() && spec[close + 1] == ':')
+          port = std::atoi(spec.c_str() + close + 2);
+      } else if (colon != std::string::npos &&
+                 spec.find(':') == colon) {
+        host = spec.substr(0, colon);
+        port = std::atoi(spec.c_str() + colon + 1);
+      }
+      net::Endpoint ep;
+      if (net::makeEndpoint(host, port, ep))
+        out.push_back(ep);
+    }
+    return out;
+  }
+
+  static void putName(std::string &pkt, const std::string &name) {
+    std::stringstream ss(name);
+    std::string label;
+    while (std::getline(ss, label, '.')) {
+      if (label.empty() || label.size() > 63)
+        continue;
+      pkt += (char)label.size();
+      pkt += label;
+    }
+    pkt += '\0';
+  }
+
+  static std::string buildQuery(uint16_t id, const std::string &name,
+                                uint16_t type) {
+    std::string pkt;
+    pkt += (char)(id >> 8);
+    pkt += (char)(id & 0xFF);
+    pkt += std::string("\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00", 10);
+    putName(pkt, name);
+    pkt += (char)(type >> 8);
+    pkt += (char)(type & 0xFF);
+    pkt += std::string("\x00\x01", 2); // class IN
+    return pkt;
+  }
+
+  // Past a (possibly compressed) name; 0 when malformed
+  static size_t skipName(const uint8_t *p, size_t len, size_t off) {
+    while (off < len) {
+      uint8_t n = p[off];
+      if (n == 0)
+        return off + 1;
+      if ((n & 0xC0) == 0xC0)
+        return off + 2 <= len ? off + 2 : 0;
+      off += (size_t)n + 1;
+    }
+    return 0;
+  }
+
+  static uint16_t u16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+  static uint32_t u32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | p[3];
+  }
+
+  // Parse a reply into ans; false when it is not a usable answer
+  static bool parseReply(const uint8_t *p, size_t len, uint16_t type,
+                         Answer &ans) {
+    if (len < 12)
+      return false;
+    uint16_t flags = u16(p + 2);
+    if ((flags & 0x0200) || (flags & 0x000F) > 3) // truncated / SERVFAIL..
+      return false;
+    size_t qd = u16(p + 4), an = u16(p + 6);
+    size_t off = 12;
+    for (size_t i = 0; i < qd && off; i++)
+      off = skipName(p, len, off) + 4;
+    for (size_t i = 0; i < an && off && off < len; i++) {
+      off = skipName(p, len, off);
+      if (!off || off + 10 > len)
+        return false;
+      uint16_t rtype = u16(p + off);
+      uint32_t ttl = u32(p + off + 4);
+      size_t rdlen = u16(p + off + 8);
+      off += 10;
+      if (off + rdlen > len)
+        return false;
+      char buf[INET6_ADDRSTRLEN] = {};
+      if (rtype == type && type == 1 && rdlen == 4)
+        inet_ntop(AF_INET, p + off, buf, sizeof(buf));
+      else if (rtype == type && type == 28 && rdlen == 16)
+        inet_ntop(AF_INET6, p + off, buf, sizeof(buf));
+      if (buf[0]) {
+        ans.addrs.push_back(buf);
+        ans.ttl = std::min(ans.ttl, ttl);
+      }
+      off += rdlen;
+    }
+    return true;
+  }
+
+  // Returns the names DNS could not answer
+  std::vector<std::string> queryDns(const std::vector<std::string> &names) {
+    std::vector<net::Endpoint> srv = servers();
+    if (names.empty() || srv.empty())
+      return names;
+
+    std::vector<net::socket_t> socks;
+    for (const net::Endpoint &ep : srv) {
+      net::socket_t s = socket(ep.family(), SOCK_DGRAM, IPPROTO_UDP);
+      if (s != net::kInvalidSocket)
+        net::setNonBlocking(s, true);
+      socks.push_back(s);
+    }
+
+    std::vector<Answer> answers(names.size());
+    std::unordered_map<uint16_t, Query> inFlight;
+    std::mt19937 rng(std::random_device{}());
+    std::vector<uint16_t> types = {1};
+    if (opts_.ipv6)
+      types.push_back(28);
+    size_t next = 0;
+
+    auto send = [&](Query q) {
+      uint16_t id;
+      do
+        id = (uint16_t)rng();
+      while (inFlight.count(id));
+      size_t s = (size_t)q.attempt % srv.size();
+      std::string pkt = buildQuery(id, names[q.name], q.type);
+      if (socks[s] != net::kInvalidSocket)
+        sendto(socks[s], pkt.data(), (int)pkt.size(), 0, srv[s].sa(),
+               srv[s].len);
+      q.deadline = std::chrono::steady_clock::now() +
+                   std::chrono::milliseconds(opts_.timeoutMs);
+      inFlight[id] = q;
+    };
+    auto finish = [&](const Query &q, bool ok) {
+      Answer &a = answers[q.name];
+      a.failed |= !ok;
+      if (--a.outstanding > 0)
+        return;
+      if (a.failed || a.addrs.empty())
+        return; // left for getaddrinfo
+      Entry e;
+      e.addrs = a.addrs;
+      e.expires = std::time(nullptr) + (time_t)a.ttl;
+      cache_[names[q.name]] = e;
+      results_[names[q.name]] = a.addrs;
+      stats_.dns++;
+    };
+
+    std::vector<net::pollfd_t> pfds(socks.size());
+    uint8_t buf[4096];
+    while (next < names.size() || !inFlight.empty()) {
+      // ── Top up to maxInFlight questions ──
+      while (next < names.size() &&
+             (int)(inFlight.size() + types.size()) <= opts_.maxInFlight) {
+        answers[next].outstanding = (int)types.size();
+        for (uint16_t t : types)
+          send(Query{next, t, 0, {}});
+        next++;
+      }
+
+      for (size_t i = 0; i < socks.size(); i++) {
+        pfds[i].fd = socks[i];
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+      }
+      net::pollSockets(pfds.data(), pfds.size(), 10);
+
+      // ── Replies ──
+      for (size_t i = 0; i < socks.size(); i++) {
+        if (socks[i] == net::kInvalidSocket)
+          continue;
+        while (true) {
+          int n = (int)recv(socks[i], (char *)buf, (int)sizeof(buf), 0);
+          if (n < 12)
+            break;
+          auto it = inFlight.find(u16(buf));
+          if (it == inFlight.end())
+            continue;
+          Query q = it->second;
+          inFlight.erase(it);
+          finish(q, parseReply(buf, (size_t)n, q.type, answers[q.name]));
+        }
+      }
+
+      // ── Timeouts: retry on the next server, then give up ──
+      auto now = std::chrono::steady_clock::now();
+      std::vector<Query> expired;
+      for (auto it = inFlight.begin(); it != inFlight.end();) {
+        if (it->second.deadline <= now) {
+          expired.push_back(it->second);
+          it = inFlight.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      for (Query &q : expired) {
+        if (++q.attempt < opts_.attempts)
+          send(q);
+        else
+          finish(q, false);
+      }
+    }
+
+    for (net::socket_t s : socks)
+      if (s != net::kInvalidSocket)
+        net::closeSocket(s);
+
+    std::vector<std::string> left;
+    for (size_t i = 0; i < names.size(); i++)
+      if (answers[i].failed || answers[i].addrs.empty())
+        left.push_back(names[i]);
+    return left;
+  }
+
+  // getaddrinfo() on a handful of threads for what DNS left over
+  void resolveSystem(const std::vector<std::string> &names) {
+    if (names.empty())
+      return;
+    std::vector<std::vector<std::string>> found(names.size());
+    std::atomic<size_t> next(0);
+    size_t workers = std::min<size_t>(16, names.size());
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; w++)
+      threads.emplace_back([&] {
+        for (size_t i; (i = next.fetch_add(1)) < names.size();)
+          found[i] = net::resolveAll(names[i], opts_.ipv6);
+      });
+    for (auto &t : threads)
+      t.join();
+
+    time_t now = std::time(nullptr);
+    for (size_t i = 0; i < names.size(); i++) {
+      results_[names[i]] = found[i];
+      if (found[i].empty()) {
+        stats_.failed++;
+        continue;
+      }
+      stats_.system++;
+      cache_[names[i]] = Entry{found[i], now + (time_t)kSystemTtl};
+    }
+  }
+
+  Options opts_;
+  bool hostsLoaded_ = false;
+  std::unordered_map<std::string, std::vector<std::string>> hosts_;
+  std::map<std::string, Entry> cache_; // sorted, so the file diffs well
+  std::unordered_map<std::string, std::vector<std::string>> results_;
+  Stats stats_;
+};
@@ -0,0 +1,304 @@
+/*
+ * epoll_engine.h - Event-driven connect engine (Linux only)
+ *
+ * Runs a small number of reactor threads (one per core by default, each
+ * pinned to its core). Every reactor keeps thousands of non-blocking
+ * connects outstanding on its own epoll instance and expires them with a
+ * hashed timer wheel, so concurrency is bounded by file descriptors rather
+ * than by thread count.
+ */
+#pragma once
+
+#ifdef __linux__
+
+#include "scan_engine.h"
+#include "socket_manager.h"
+
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <thread>
+#include <vector>
+
+// ─────────────────────────────────────────────
+//  Timer Wheel
+// ─────────────────────────────────────────────
+// Hashed wheel over connection slot indices. Insert/remove are O(1) via
+// intrusive doubly-linked lists; advancing visits one bucket per tick.
+class TimerWheel {
+public:
+  TimerWheel(size_t slots, size_t buckets)
+      : next_(slots, -1), prev_(slots, -1), tick_(slots, 0),
+        heads_(buckets, -1) {}
+
+  void insert(int slot, uint64_t expireTick) {
+    tick_[slot] = expireTick;
+    int &head = heads_[expireTick % heads_.size()];
+    prev_[slot] = -1;
+    next_[slot] = head;
+    if (head >= 0)
+      prev_[head] = slot;
+    head = slot;
+  }
+
+  void remove(int slot) {
+    if (prev_[slot] >= 0)
+      next_[prev_[slot]] = next_[slot];
+    else
+      heads_[tick_[slot] % heads_.size()] = next_[slot];
+    if (next_[slot] >= 0)
+      prev_[next_[slot]] = prev_[slot];
+    next_[slot] = prev_[slot] = -1;
+  }
+
+  // Pop every slot due at or before nowTick, calling fn(slot)
+  template <class F> void advance(uint64_t nowTick, F &&fn) {
+    for (; current_ <= nowTick; current_++) {
+      int slot = heads_[current_ % heads_.size()];
+      while (slot >= 0) {
+        int nxt = next_[slot];
+        if (tick_[slot] <= nowTick) {
+          remove(slot);
+          fn(slot);
+        }
+        slot = nxt;
+      }
+    }
+    current_ = nowTick; // re-scan the current bucket on the next call
+  }
+
+  void start(uint64_t nowTick) { current_ = nowTick; }
+
+private:
+  std::vector<int> next_, prev_;
+  std::vector<uint64_t> tick_;
+  std::vector<int> heads_;
+  uint64_t current_ = 0;
+};
+
+// ─────────────────────────────────────────────
+//  Epoll Multi-Reactor Engine
+// ─────────────────────────────────────────────
+class EpollEngine {
+public:
+  explicit EpollEngine(const EngineOptions &opts) : opts_(opts) {}
+
+  void run(const ProbeSource &source, const ProbeSink &sink) {
+    int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+    int reactors = opts_.reactors > 0 ? opts_.reactors : cores;
+
+    if (!opts_.sockets)
+      opts_.sockets = &ownSockets_;
+
+    // Keep total in-flight sockets inside the fd budget
+    int budget = (int)std::min<long>(opts_.maxInFlight,
+                                     opts_.sockets->budget());
+    int perReactor = std::max(1, budget / reactors);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < reactors; i++) {
+      threads.emplace_back([this, i, cores, perReactor, &source, &sink] {
+        if (opts_.pinThreads)
+          pinToCore(i % cores);
+        reactorLoop(perReactor, source, sink);
+      });
+    }
+    for (auto &t : threads)
+      t.join();
+  }
+
+private:
+  static constexpr int kTickMs = 5;
+
+  struct Conn {
+    int fd = -1;
+    Probe probe;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  static void pinToCore(int core) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  // Fills both elapsed fields of out
+  static void setElapsed(ProbeOutcome &out,
+                         std::chrono::steady_clock::time_point t) {
+    out.elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - t)
+                        .count();
+    out.elapsedMs = (long)(out.elapsedUs / 1000);
+  }
+
+  static uint64_t nowTick(std::chrono::steady_clock::time_point epoch) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - epoch)
+               .count() /
+           kTickMs;
+  }
+
+  void reactorLoop(int capacity, const ProbeSource &source,
+                   const ProbeSink &sink) {
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0)
+      return;
+
+    auto epoch = std::chrono::steady_clock::now();
+    uint64_t timeoutTicks = (uint64_t)(opts_.timeoutMs + kTickMs - 1) / kTickMs;
+    TimerWheel wheel((size_t)capacity, (size_t)timeoutTicks + 2);
+    wheel.start(0);
+
+    std::vector<Conn> conns((size_t)capacity);
+    std::vector<int> freeSlots;
+    for (int i = capacity - 1; i >= 0; i--)
+      freeSlots.push_back(i);
+
+    std::vector<epoll_event> events(256);
+    int inFlight = 0;
+    bool exhausted = false;
+    bool fdStarved = false;
+    Probe pending;
+    bool havePending = false;
+    Throttle *throttle = opts_.throttle;
+    SocketManager &sockets = *opts_.sockets;
+    auto starvedSince = std::chrono::steady_clock::time_point();
+
+    // Every outcome passes through here so the throttle sees it
+    auto complete = [&](const Probe &p, const ProbeOutcome &out) {
+      if (throttle)
+        throttle->release(p.ticket, out);
+      sink(p, out);
+    };
+
+    auto finish = [&](int slot, net::ConnectStatus status, int err) {
+      Conn &c = conns[slot];
+      ProbeOutcome out;
+      out.status = status;
+      out.unreachable = net::unreachableError(err);
+      setElapsed(out, c.start);
+      if (opts_.keepOpen && status == net::ConnectStatus::Open) {
+        epoll_ctl(ep, EPOLL_CTL_DEL, c.fd, nullptr);
+        out.sock = c.fd;
+      } else {
+        sockets.close(c.fd); // also drops it from the epoll set
+      }
+      c.fd = -1;
+      freeSlots.push_back(slot);
+      inFlight--;
+      complete(c.probe, out);
+    };
+
+    while (true) {
+      // ── Fill the window with new connects ──
+      fdStarved = false;
+      while (!freeSlots.empty() && !fdStarved) {
+        Probe p;
+        if (havePending) {
+          p = pending; // already admitted by the throttle
+          havePending = false;
+        } else {
+          if (exhausted)
+            break;
+          uint64_t ticket = 0;
+          if (throttle && !throttle->tryAcquire(ticket))
+            break; // window full or paced: retry after the next tick
+          if (!source(p)) {
+            if (throttle)
+              throttle->cancel(ticket);
+            exhausted = true;
+            break;
+          }
+          p.ticket = ticket;
+        }
+
+        int err = 0;
+        int fd = sockets.open(p.ep, err);
+        auto start = std::chrono::steady_clock::now();
+        int rc = fd < 0 ? -1 : connect(fd, p.ep.sa(), p.ep.len);
+        if (rc != 0 && fd >= 0)
+          err = errno;
+        if (rc != 0 && err != EINPROGRESS && SocketManager::isShortage(err)) {
+          if (fd >= 0) {
+            sockets.close(fd);
+            sockets.noteShortage();
+            fd = -1;
+          }
+          // Out of descriptors or source ports: hold the probe until
+          // sockets are released, unless that takes far too long
+          if (starvedSince == std::chrono::steady_clock::time_point())
+            starvedSince = start;
+          if (start - starvedSince <
+              std::chrono::milliseconds(SocketManager::kMaxStallMs)) {
+            pending = p;
+            havePending = true;
+            fdStarved = true;
+            break;
+          }
+        }
+        starvedSince = std::chrono::steady_clock::time_point();
+        if (fd < 0) {
+          complete(p, ProbeOutcome());
+          continue;
+        }
+        if (rc == 0 || err != EINPROGRESS) {
+          ProbeOutcome out;
+          out.status = net::classifyConnectError(rc == 0 ? 0 : err);
+          out.unreachable = rc != 0 && net::unreachableError(err);
+          setElapsed(out, start);
+          if (opts_.keepOpen && out.status == net::ConnectStatus::Open)
+            out.sock = fd;
+          else
+            sockets.close(fd);
+          complete(p, out);
+          continue;
+        }
+
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        Conn &c = conns[slot];
+        c.fd = fd;
+        c.probe = p;
+        c.start = start;
+
+        epoll_event ev{};
+        ev.events = EPOLLOUT | EPOLLERR | EPOLLHUP;
+        ev.data.u32 = (uint32_t)slot;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+        uint64_t ticks = timeoutTicks;
+        if (p.timeoutMs > 0 && p.timeoutMs < opts_.timeoutMs)
+          ticks = (uint64_t)(p.timeoutMs + kTickMs - 1) / kTickMs;
+        wheel.insert(slot, nowTick(epoch) + ticks);
+        inFlight++;
+      }
+
+      if (inFlight == 0 && exhausted && !havePending)
+        break;
+
+      // ── Wait for completions (at most one tick) ──
+      int n = epoll_wait(ep, events.data(), (int)events.size(), kTickMs);
+      for (int i = 0; i < n; i++) {
+        int slot = (int)events[i].data.u32;
+        if (conns[slot].fd < 0)
+          continue;
+        wheel.remove(slot);
+        int err = net::pendingError(conns[slot].fd);
+        finish(slot, net::classifyPendingError(err), err);
+      }
+
+      // ── Expire connects past their deadline ──
+      wheel.advance(nowTick(epoch), [&](int slot) {
+        finish(slot, net::ConnectStatus::TimedOut, 0);
+      });
+    }
+
+    close(ep);
+  }
+
+  EngineOptions opts_;
+  SocketManager ownSockets_; // when the caller brings none
+};
+
+#endif // __linux__
@@ -0,0 +1,459 @@
+/*
+ * fingerprint.h - Banner fingerprint rules and a one-pass matcher
+ *
+ * Rules use the match line syntax of nmap-service-probes:
+ *
+ *   match     <service> m|<regex>|[i][s] [p/<product>/] [v/<version>/]
+ *                                         [i/<info>/] [o/<os>/]
+ *   softmatch <service> m|<regex>|[i][s]
+ *
+ * Any delimiter may follow 'm' and the field letters; $1..$9 in the
+ * fields are replaced by regex captures. Rules are tried in file order and
+ * the first match wins (a softmatch only names the service, and loses to
+ * any later hard match).
+ *
+ * At load time the longest literal every match must contain is pulled
+ * out of each regex, and all literals are compiled into one Aho-Corasick
+ * automaton (case-insensitive, byte classes for a compact table). A
+ * banner is scanned once; only rules whose literal occurs, plus the few
+ * rules without a usable literal, have their regex run to confirm and to
+ * extract the version. Cost per banner therefore tracks the number of
+ * plausible rules, not the size of the rule set.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <regex>
+#include <string>
+#include <vector>
+
+// ─────────────────────────────────────────────
+//  Aho-Corasick Automaton
+// ─────────────────────────────────────────────
+// Case-insensitive multi-literal search. Bytes that occur in no pattern
+// share one class, so each state's transition row stays short.
+class AhoCorasick {
+public:
+  // Returns the pattern's index (0, 1, ...) for use in match callbacks
+  int add(const std::string &literal) {
+    int state = 0;
+    for (unsigned char c : literal) {
+      unsigned char lc = (unsigned char)std::tolower(c);
+      int next = -1;
+      for (const auto &e : trie_[(size_t)state].edges)
+        if (e.first == lc) {
+          next = e.second;
+          break;
+        }
+      if (next < 0) {
+        next = (int)trie_.size();
+        trie_[(size_t)state].edges.push_back({lc, next});
+        trie_.push_back(TrieNode());
+      }
+      state = next;
+    }
+    int id = patterns_++;
+    trie_[(size_t)state].out.push_back(id);
+    return id;
+  }
+
+  // Turn the trie into a DFA (call once after the last add)
+  void compile() {
+    // Byte classes: 0 for bytes outside every pattern
+    std::fill(std::begin(class_), std::end(class_), (uint8_t)0);
+    classes_ = 1;
+    for (const auto &n : trie_)
+      for (const auto &e : n.edges)
+        if (class_[e.first] == 0) {
+          class_[e.first] = (uint8_t)classes_;
+          class_[std::toupper(e.first)] = (uint8_t)classes_;
+          classes_++;
+        }
+
+    size_t states = trie_.size();
+    next_.assign(states * classes_, 0);
+    std::vector<int> fail(states, 0);
+    std::vector<std::vector<int>> out(states);
+    for (size_t s = 0; s < states; s++)
+      out[s] = trie_[s].out;
+
+    // BFS: fill missing transitions from the failure state
+    std::queue<int> q;
+    for (const auto &e : trie_[0].edges) {
+      next_[class_[e.first]] = e.second;
+      q.push(e.second);
+    }
+    while (!q.empty()) {
+      int s = q.front();
+      q.pop();
+      const std::vector<int> &fo = out[(size_t)fail[(size_t)s]];
+      out[(size_t)s].insert(out[(size_t)s].end(), fo.begin(), fo.end());
+      for (size_t c = 0; c < classes_; c++)
+        next_[(size_t)s * classes_ + c] =
+            next_[(size_t)fail[(size_t)s] * classes_ + c];
+      for (const auto &e : trie_[(size_t)s].edges) {
+        fail[(size_t)e.second] =
+            next_[(size_t)fail[(size_t)s] * classes_ + class_[e.first]];
+        next_[(size_t)s * classes_ + class_[e.first]] = e.second;
+        q.push(e.second);
+      }
+    }
+
+    // Flatten per-state outputs
+    outStart_.assign(states + 1, 0);
+    outIds_.clear();
+    for (size_t s = 0; s < states; s++) {
+      outStart_[s] = (uint32_t)outIds_.size();
+      outIds_.insert(outIds_.end(), out[s].begin(), out[s].end());
+    }
+    outStart_[states] = (uint32_t)outIds_.size();
+    trie_.clear();
+    trie_.shrink_to_fit();
+  }
+
+  // Calls hit(patternId) for every occurrence in data
+  template <class F> void scan(const char *data, size_t len, F &&hit) const {
+    if (next_.empty())
+      return;
+    size_t s = 0;
+    for (size_t i = 0; i < len; i++) {
+      s = (size_t)next_[s * classes_ + class_[(unsigned char)data[i]]];
+      for (uint32_t k = outStart_[s]; k < outStart_[s + 1]; k++)
+        hit(outIds_[k]);
+    }
+  }
+
+  int patterns() const { return patterns_; }
+
+private:
+  struct TrieNode {
+    std::vector<std::pair<unsigned char, int>> edges;
+    std::vector<int> out;
+  };
+
+  std::vector<TrieNode> trie_{TrieNode()};
+  int patterns_ = 0;
+
+  uint8_t class_[256];
+  size_t classes_ = 1;
+  std::vector<int32_t> next_;      // states x classes
+  std::vector<uint32_t> outStart_; // per state, into outIds_
+  std::vector<int> outIds_;
+};
+
+// ─────────────────────────────────────────────
+//  Fingerprint Rule Set
+// ─────────────────────────────────────────────
+struct Fingerprint {
+  std::string service; // e.g. "ssh"
+  std::string product; // product/version/info with captures filled in
+};
+
+class FingerprintDb {
+public:
+  size_t size() const { return rules_.size(); }
+
+  // Parse a rules file; on error err names the line
+  bool loadFile(const std::string &path, std::string &err) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+      err = "cannot open " + path;
+      return false;
+    }
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+      lineNo++;
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      size_t start = line.find_first_not_of(" \t");
+      if (start == std::string::npos || line[start] == '#')
+        continue;
+      if (!addRule(line.substr(start), err)) {
+        err = path + ":" + std::to_string(lineNo) + ": " + err;
+        return false;
+      }
+    }
+    compile();
+    return true;
+  }
+
+  // Classify a raw banner; false when no rule matches
+  bool match(const std::string &banner, Fingerprint &fp) const {
+    if (rules_.empty() || banner.empty())
+      return false;
+
+    // One automaton pass marks the rules worth a regex attempt
+    std::vector<int> candidates(always_);
+    ac_.scan(banner.data(), banner.size(),
+             [&](int lit) { candidates.push_back(litRule_[(size_t)lit]); });
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+
+    const Rule *soft = nullptr;
+    std::smatch m;
+    for (int idx : candidates) {
+      const Rule &r = rules_[(size_t)idx];
+      if (soft && r.soft)
+        continue;
+      if (!std::regex_search(banner, m, r.re))
+        continue;
+      if (r.soft) {
+        soft = &r;
+        continue;
+      }
+      fp.service = r.service;
+      fp.product = expand(r, m);
+      return true;
+    }
+    if (soft) {
+      fp.service = soft->service;
+      fp.product.clear();
+      return true;
+    }
+    return false;
+  }
+
+private:
+  struct Rule {
+    bool soft;
+    std::string service;
+    std::regex re;
+    std::string fields[4]; // p v i o
+  };
+
+  bool addRule(const std::string &line, std::string &err) {
+    size_t pos = 0;
+    std::string kind = word(line, pos);
+    if (kind != "match" && kind != "softmatch") {
+      err = "expected match/softmatch";
+      return false;
+    }
+    Rule r;
+    r.soft = kind == "softmatch";
+    r.service = word(line, pos);
+
+    // m<delim>regex<delim>flags
+    skipSpace(line, pos);
+    std::string pattern;
+    if (pos + 1 >= line.size() || line[pos] != 'm' ||
+        !delimited(line, ++pos, pattern)) {
+      err = "bad pattern";
+      return false;
+    }
+    bool icase = false, dotall = false;
+    while (pos < line.size() && (line[pos] == 'i' || line[pos] == 's')) {
+      (line[pos] == 'i' ? icase : dotall) = true;
+      pos++;
+    }
+
+    // Version fields
+    while (true) {
+      skipSpace(line, pos);
+      if (pos + 1 >= line.size())
+        break;
+      const char *slots = "pvio";
+      const char *slot = std::strchr(slots, line[pos]);
+      std::string value;
+      if (!slot || !delimited(line, ++pos, value)) {
+        // Fields nmap defines but we do not use (cpe:, h/, d/)
+        while (pos < line.size() && line[pos] != ' ')
+          pos++;
+        continue;
+      }
+      r.fields[slot - slots] = value;
+    }
+
+    auto flags = std::regex::ECMAScript | std::regex::optimize;
+    if (icase)
+      flags |= std::regex::icase;
+    try {
+      r.re = std::regex(dotall ? dotAll(pattern) : pattern, flags);
+    } catch (const std::regex_error &) {
+      err = "regex does not compile: " + pattern;
+      return false;
+    }
+
+    int idx = (int)rules_.size();
+    std::string lit = requiredLiteral(pattern);
+    if (lit.size() >= 3) {
+      ac_.add(lit);
+      litRule_.push_back(idx);
+    } else {
+      always_.push_back(idx);
+    }
+    rules_.push_back(std::move(r));
+    return true;
+  }
+
+  void compile() { ac_.compile(); }
+
+  static void skipSpace(const std::string &s, size_t &pos) {
+    while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t'))
+      pos++;
+  }
+
+  static std::string word(const std::string &s, size_t &pos) {
+    skipSpace(s, pos);
+    size_t start = pos;
+    while (pos < s.size() && s[pos] != ' ' && s[pos] != '\t')
+      pos++;
+    return s.substr(start, pos - start);
+  }
+
+  // pos at the opening delimiter; leaves pos after the closing one
+  static bool delimited(const std::string &s, size_t &pos, std::string &out) {
+    if (pos >= s.size())
+      return false;
+    char d = s[pos++];
+    size_t end = s.find(d, pos);
+    if (end == std::string::npos)
+      return false;
+    out = s.substr(pos, end - pos);
+    pos = end + 1;
+    return true;
+  }
+
+  // ECMAScript has no dotall flag: make unescaped '.' match newlines
+  static std::string dotAll(const std::string &re) {
+    std::string out;
+    bool inClass = false;
+    for (size_t i = 0; i < re.size(); i++) {
+      char c = re[i];
+      if (c == '\\' && i + 1 < re.size()) {
+        out += c;
+        out += re[++i];
+        continue;
+      }
+      if (c == '[')
+        inClass = true;
+      else if (c == ']')
+        inClass = false;
+      if (c == '.' && !inClass)
+        out += "[\\s\\S]";
+      else
+        out += c;
+    }
+    return out;
+  }
+
+  // Longest run of literal bytes at the top level of the regex that any
+  // match must contain; empty when alternation makes that unknowable
+  static std::string requiredLiteral(const std::string &re) {
+    std::string best, run;
+    int depth = 0;
+    auto flush = [&]() {
+      if (run.size() > best.size())
+        best = run;
+      run.clear();
+    };
+
+    size_t i = 0;
+    while (i < re.size()) {
+      // ── Read one atom: literal byte (lit >= 0) or anything else ──
+      int lit = -1;
+      char c = re[i++];
+      if (c == '\\' && i < re.size()) {
+        char e = re[i++];
+        if (e == 'r')
+          lit = '\r';
+        else if (e == 'n')
+          lit = '\n';
+        else if (e == 't')
+          lit = '\t';
+        else if (e == 'x' && i + 2 <= re.size()) {
+          lit = (int)std::strtol(re.substr(i, 2).c_str(), nullptr, 16);
+          i += 2;
+        } else if (e == 'u')
+          i = std::min(re.size(), i + 4);
+        else if (e == 'c')
+          i = std::min(re.size(), i + 1);
+        else if (!std::isalnum((unsigned char)e))
+          lit = (unsigned char)e; // escaped punctuation
+      } else if (c == '[') {
+        while (i < re.size() && re[i] != ']')
+          i += re[i] == '\\' ? 2 : 1;
+        i++;
+      } else if (c == '(') {
+        depth++;
+      } else if (c == ')') {
+        depth--;
+      } else if (c == '|') {
+        if (depth == 0)
+          return std::string();
+      } else if (!std::strchr(".^$*+?{}", c)) {
+        lit = (unsigned char)c;
+      }
+
+      // ── Quantifier after the atom ──
+      bool optional = false;
+      if (i < re.size() && (re[i] == '*' || re[i] == '?')) {
+        optional = true;
+      } else if (i < re.size() && re[i] == '{') {
+        optional = i + 1 < re.size() && re[i + 1] == '0';
+        size_t close = re.find('}', i);
+        if (close != std::string::npos) {
+          // {n,m}: the atom is required but the run ends here
+          if (lit >= 0 && depth == 0 && !optional)
+            run += (char)lit;
+          flush();
+          i = close + 1;
+          continue;
+        }
+      }
+
+      if (lit < 0 || depth > 0 || optional) {
+        flush();
+        continue;
+      }
+      run += (char)lit;
+      if (i < re.size() && re[i] == '+') {
+        flush(); // x+ : one x is certain, what follows may be more x
+      }
+    }
+    flush();
+    return best;
+  }
+
+  // Field text with $1..$9 replaced by captures, joined "p v (i)"
+  static std::string expand(const Rule &r, const std::smatch &m) {
+    std::string parts[4];
+    for (int f = 0; f < 4; f++) {
+      const std::string &src = r.fields[f];
+      for (size_t i = 0; i < src.size(); i++) {
+        if (src[i] == '$' && i + 1 < src.size() &&
+            std::isdigit((unsigned char)src[i + 1])) {
+          size_t g = (size_t)(src[++i] - '0');
+          if (g < m.size())
+            parts[f] += m[g].str();
+        } else {
+          parts[f] += src[i];
+        }
+      }
+      // An empty capture can leave stray spaces ("$3 protocol $1")
+      size_t b = parts[f].find_first_not_of(' ');
+      size_t e = parts[f].find_last_not_of(' ');
+      parts[f] = b == std::string::npos ? "" : parts[f].substr(b, e - b + 1);
+    }
+    std::string out = parts[0];
+    if (!parts[1].empty())
+      out += (out.empty() ? "" : " ") + parts[1];
+    if (!parts[2].empty())
+      out += (out.empty() ? "(" : " (") + parts[2] + ")";
+    if (!parts[3].empty())
+      out += (out.empty() ? "" : " ") + std::string("[") + parts[3] + "]";
+    return out;
+  }
+
+  std::vector<Rule> rules_;
+  AhoCorasick ac_;
+  std::vector<int> litRule_; // literal index -> rule index
+  std::vector<int> always_;  // rules without a usable literal
+};
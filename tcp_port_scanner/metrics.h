@@ -0,0 +1,228 @@
+/*
+ * metrics.h - Latency histograms and scan counters
+ *
+ * LatencyHistogram is HDR-style: values (microseconds) below 32 get a
+ * bucket each, above that every power of two is split into 32 linear
+ * sub-buckets, so any recorded value is known to within ~3% at a fixed
+ * 9 KB per histogram. Recording is one relaxed atomic add (plus a rarely
+ * taken max update), cheap enough for every probe on every engine thread.
+ *
+ * ScanMetrics groups one histogram per pipeline phase with the outcome
+ * counters, prints the percentile table at the end of a scan and renders
+ * the Prometheus text format for --metrics.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+// ─────────────────────────────────────────────
+//  Latency Histogram
+// ─────────────────────────────────────────────
+class LatencyHistogram {
+public:
+  LatencyHistogram() { reset(); }
+
+  void reset() {
+    for (auto &b : buckets_)
+      b.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  // Any thread
+  void record(uint64_t us) {
+    us = std::min(us, kMaxValue);
+    buckets_[index(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t m = max_.load(std::memory_order_relaxed);
+    while (us > m && !max_.compare_exchange_weak(m, us,
+                                                 std::memory_order_relaxed)) {
+    }
+  }
+
+  void recordSince(std::chrono::steady_clock::time_point start) {
+    record((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start)
+               .count());
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  // Smallest bucket value v such that at least p% of samples are <= v
+  // (reported as the bucket's upper end, capped at the max seen)
+  uint64_t percentile(double p) const {
+    uint64_t total = count();
+    if (total == 0)
+      return 0;
+    uint64_t want = (uint64_t)(p / 100.0 * (double)total + 0.5);
+    want = std::max<uint64_t>(1, std::min(want, total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen >= want)
+        return std::min(highestIn(i), max());
+    }
+    return max();
+  }
+
+private:
+  static constexpr int kSubBits = 5;
+  static constexpr uint64_t kSub = 1ull << kSubBits;
+  static constexpr int kMaxBits = 40; // ~12.7 days in microseconds
+  static constexpr uint64_t kMaxValue = (1ull << kMaxBits) - 1;
+  static constexpr size_t kBuckets = (size_t)(kMaxBits - kSubBits + 1) * kSub;
+
+  static int msb(uint64_t v) {
+    int n = 0;
+    while (v >>= 1)
+      n++;
+    return n;
+  }
+
+  static size_t index(uint64_t v) {
+    if (v < kSub)
+      return (size_t)v;
+    int shift = msb(v) - kSubBits;
+    return (size_t)(shift + 1) * kSub + (size_t)((v >> shift) - kSub);
+  }
+
+  static uint64_t highestIn(size_t idx) {
+    if (idx < kSub)
+      return idx;
+    int shift = (int)(idx / kSub) - 1;
+    uint64_t low = (kSub + idx % kSub) << shift;
+    return low + (1ull << shift) - 1;
+  }
+
+  std::atomic<uint64_t> buckets_[kBuckets];
+  std::atomic<uint64_t> count_, sum_, max_;
+};
+
+// ─────────────────────────────────────────────
+//  Scan Metrics
+// ─────────────────────────────────────────────
+class ScanMetrics {
+public:
+  enum Phase {
+    kAdmit,       // waiting for the congestion window (thread engine)
+    kConnect,     // connect() until open / refused / timeout
+    kBannerQueue, // open socket waiting for a banner slot
+    kBannerRead,  // banner request + recv
+    kReport,      // result queued until the reporter printed it
+    kPhaseCount
+  };
+
+  static const char *phaseName(int p) {
+    static const char *names[kPhaseCount] = {"admit", "connect",
+                                             "banner_queue", "banner_read",
+                                             "report"};
+    return names[p];
+  }
+
+  LatencyHistogram &phase(Phase p) { return phases_[p]; }
+  const LatencyHistogram &phase(Phase p) const { return phases_[p]; }
+
+  void reset() {
+    for (auto &h : phases_)
+      h.reset();
+    for (auto *c : {&started_, &open_, &refused_, &timedOut_, &errors_})
+      c->store(0, std::memory_order_relaxed);
+  }
+
+  // A connect is about to be issued
+  void connectStarted() { started_.fetch_add(1, std::memory_order_relaxed); }
+
+  // A connect finished; status is 0 open, 1 refused, 2 timed out, 3 error
+  void connectDone(int status, uint64_t us) {
+    std::atomic<uint64_t> *c[] = {&open_, &refused_, &timedOut_, &errors_};
+    c[std::min(status, 3)]->fetch_add(1, std::memory_order_relaxed);
+    phases_[kConnect].record(us);
+  }
+
+  uint64_t finished() const {
+    return open_.load(std::memory_order_relaxed) +
+           refused_.load(std::memory_order_relaxed) +
+           timedOut_.load(std::memory_order_relaxed) +
+           errors_.load(std::memory_order_relaxed);
+  }
+  uint64_t inFlight() const {
+    uint64_t s = started_.load(std::memory_order_relaxed), f = finished();
+    return s > f ? s - f : 0;
+  }
+  uint64_t refused() const { return refused_.load(std::memory_order_relaxed); }
+  uint64_t timedOut() const {
+    return timedOut_.load(std::memory_order_relaxed);
+  }
+  uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+
+  // "412us", "3.25ms", "1.20s"
+  static std::string formatUs(uint64_t us) {
+    char buf[32];
+    if (us < 1000)
+      std::snprintf(buf, sizeof(buf), "%lluus", (unsigned long long)us);
+    else if (us < 1000000)
+      std::snprintf(buf, sizeof(buf), "%.2fms", (double)us / 1e3);
+    else
+      std::snprintf(buf, sizeof(buf), "%.2fs", (double)us / 1e6);
+    return buf;
+  }
+
+  // Prometheus text exposition; phases as summaries in seconds
+  std::string prometheus(uint64_t scanned, uint64_t planned) const {
+    std::ostringstream os;
+    os << "# HELP portscan_phase_seconds Time spent per pipeline phase.\n"
+       << "# TYPE portscan_phase_seconds summary\n";
+    for (int p = 0; p < kPhaseCount; p++) {
+      const LatencyHistogram &h = phases_[p];
+      for (double q : {0.5, 0.9, 0.99})
+        os << "portscan_phase_seconds{phase=\"" << phaseName(p)
+           << "\",quantile=\"" << q << "\"} " << seconds(h.percentile(q * 100))
+           << "\n";
+      os << "portscan_phase_seconds_sum{phase=\"" << phaseName(p) << "\"} "
+         << seconds(h.sum()) << "\n"
+         << "portscan_phase_seconds_count{phase=\"" << phaseName(p) << "\"} "
+         << h.count() << "\n";
+    }
+
+    os << "# HELP portscan_connects_total Finished connects by outcome.\n"
+       << "# TYPE portscan_connects_total counter\n";
+    const char *names[] = {"open", "refused", "timeout", "error"};
+    const std::atomic<uint64_t> *c[] = {&open_, &refused_, &timedOut_,
+                                        &errors_};
+    for (int i = 0; i < 4; i++)
+      os << "portscan_connects_total{result=\"" << names[i] << "\"} "
+         << c[i]->load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP portscan_connects_in_flight Connects currently pending.\n"
+       << "# TYPE portscan_connects_in_flight gauge\n"
+       << "portscan_connects_in_flight " << inFlight() << "\n"
+       << "# HELP portscan_probes_done Probes with a final result.\n"
+       << "# TYPE portscan_probes_done gauge\n"
+       << "portscan_probes_done " << scanned << "\n"
+       << "# HELP portscan_probes_planned Probes in the whole scan.\n"
+       << "# TYPE portscan_probes_planned gauge\n"
+       << "portscan_probes_planned " << planned << "\n";
+    return os.str();
+  }
+
+private:
+  static std::string seconds(uint64_t us) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.6f", (double)us / 1e6);
+    return buf;
+  }
+
+  LatencyHistogram phases_[kPhaseCount];
+  std::atomic<uint64_t> started_{0}, open_{0}, refused_{0}, timedOut_{0},
+      errors_{0};
+};
@@ -0,0 +1,57 @@
+/*
+ * mpsc_queue.h - Unbounded lock-free multi-producer / single-consumer queue
+ *
+ * Vyukov's node-based design: a producer swaps itself in as the new head
+ * with one atomic exchange and then links the previous head to it, so
+ * pushes never wait on each other or on the consumer. Only one thread may
+ * pop. A producer that was preempted between the exchange and the link
+ * briefly hides the items behind it; pop() then reports empty and the
+ * consumer simply picks them up on its next drain.
+ */
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+template <class T> class MpscQueue {
+public:
+  MpscQueue() : head_(new Node()), tail_(head_.load()) {}
+
+  ~MpscQueue() {
+    T discard;
+    while (pop(discard)) {
+    }
+    delete tail_;
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Any thread
+  void push(T value) {
+    Node *node = new Node();
+    node->value = std::move(value);
+    Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Consumer thread only; false when (momentarily) empty
+  bool pop(T &out) {
+    Node *next = tail_->next.load(std::memory_order_acquire);
+    if (!next)
+      return false;
+    out = std::move(next->value);
+    delete tail_;
+    tail_ = next; // becomes the new stub
+    return true;
+  }
+
+private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    T value;
+  };
+
+  std::atomic<Node *> head_;
+  Node *tail_;
+};
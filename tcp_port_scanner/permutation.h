@@ -0,0 +1,64 @@
+/*
+ * permutation.h - Seeded bijective shuffle of a probe index range
+ *
+ * A 4-round balanced Feistel network over the smallest even bit width
+ * covering [0, n), with cycle walking: outputs >= n are encrypted again
+ * until they land inside the range. The result is a permutation of
+ * [0, n) that needs O(1) memory and can be evaluated at any index, so
+ * work is still generated lazily and in any order across threads.
+ */
+#pragma once
+
+#include <cstdint>
+
+class FeistelPermutation {
+public:
+  FeistelPermutation(uint64_t n, uint64_t seed) : n_(n) {
+    int bits = 2;
+    while (bits < 64 && (1ull << bits) < n)
+      bits += 2;
+    halfBits_ = bits / 2;
+    mask_ = (1ull << halfBits_) - 1;
+    uint64_t s = seed;
+    for (auto &k : keys_)
+      k = splitmix(s);
+  }
+
+  uint64_t size() const { return n_; }
+
+  // Image of index i (i < size())
+  uint64_t operator()(uint64_t i) const {
+    if (n_ <= 1)
+      return i;
+    uint64_t x = encrypt(i);
+    while (x >= n_) // cycle walk back into [0, n)
+      x = encrypt(x);
+    return x;
+  }
+
+private:
+  static uint64_t splitmix(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t encrypt(uint64_t x) const {
+    uint64_t left = x >> halfBits_;
+    uint64_t right = x & mask_;
+    for (uint64_t k : keys_) {
+      uint64_t s = right ^ k;
+      uint64_t f = splitmix(s) & mask_;
+      uint64_t next = left ^ f;
+      left = right;
+      right = next;
+    }
+    return (left << halfBits_) | right;
+  }
+
+  uint64_t n_;
+  int halfBits_;
+  uint64_t mask_;
+  uint64_t keys_[4];
+};
@@ -1,19 +1,32 @@
 /*
  * ╔══════════════════════════════════════════════════════════════════╗
  * ║           TCP PORT SCANNER - Advanced Network Tool              ║
- * ║         Written in C++ | Windows (Winsock2) Compatible          ║
+ * ║       Written in C++ | Windows (Winsock2) & Linux (POSIX)       ║
  * ╚══════════════════════════════════════════════════════════════════╝
  *
  * Features:
  *   - Multi-threaded scanning (up to 500 threads)
+ *   - epoll multi-reactor engine for very wide sweeps (Linux)
+ *   - io_uring batched connect/recv engine (Linux 5.6+)
+ *   - Raw SYN half-open scan (-sS, Linux, root)
+ *   - Simulated network engine for benchmarks (--sim)
+ *   - Per-phase latency percentiles, Prometheus metrics file
+ *   - RST close, source address/port binding, fd budget with backpressure
  *   - Service/banner detection
  *   - Custom port ranges & individual ports
+ *   - Likeliest-open ports first, --top-ports, frequencies learned from
+ *     earlier results
+ *   - Jobs split across processes/nodes with --shard i/N, --merge
+ *   - Multiple targets: CIDR blocks, address ranges, target files
+ *   - Concurrent hostname resolution with a TTL-aware DNS cache
  *   - Response time measurement
  *   - Color-coded output
  *   - Export results to file
  *
  * Compile:
- *   g++ -o port_scanner port_scanner.cpp -lws2_32 -lpthread -std=c++17 -O2
+ *   Windows: g++ -o port_scanner port_scanner.cpp -lws2_32 -std=c++17 -O2
+ *   Linux  : make            (or: g++ -o port_scanner port_scanner.cpp
+ *                              -lpthread -std=c++17 -O2)
  *
  * Usage:
  *   port_scanner.exe <target> [options]
@@ -21,12 +34,26 @@
  *   port_scanner.exe example.com -p 80,443,8080 -t 200 -o result.txt
  */
 
-/* winsock2.h MUST be included before windows.h */
-#define _WIN32_WINNT 0x0601
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include "banner_stage.h"
+#include "checkpoint.h"
+#include "congestion.h"
+#include "dns_resolver.h"
+#include "epoll_engine.h"
+#include "fingerprint.h"
+#include "metrics.h"
+#include "mpsc_queue.h"
+#include "result_store.h"
+#include "result_stream.h"
+#include "rtt.h"
+#include "scan_engine.h"
+#include "scheduler.h"
+#include "service_db.h"
+#include "sim_transport.h"
+#include "socket_manager.h"
+#include "syn_engine.h"
+#include "targets.h"
+#include "transport.h"
+#include "uring_engine.h"
 
 #include <algorithm>
 #include <atomic>
@@ -37,13 +64,13 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
-#include <map>
+#include <memory>
 #include <mutex>
-#include <queue>
-#include <set>
+#include <random>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
 // ─────────────────────────────────────────────
@@ -69,111 +96,168 @@ const std::string BWHITE = "\033[1;37m";
 // ─────────────────────────────────────────────
 //  Well-Known Port Services
 // ─────────────────────────────────────────────
-const std::map<int, std::string> SERVICES = {
-    {21, "FTP"},
-    {22, "SSH"},
-    {23, "Telnet"},
-    {25, "SMTP"},
-    {53, "DNS"},
-    {67, "DHCP"},
-    {68, "DHCP"},
-    {69, "TFTP"},
-    {80, "HTTP"},
-    {110, "POP3"},
-    {111, "RPC"},
-    {119, "NNTP"},
-    {123, "NTP"},
-    {135, "MSRPC"},
-    {137, "NetBIOS"},
-    {138, "NetBIOS"},
-    {139, "NetBIOS-SSN"},
-    {143, "IMAP"},
-    {161, "SNMP"},
-    {179, "BGP"},
-    {194, "IRC"},
-    {389, "LDAP"},
-    {443, "HTTPS"},
-    {445, "SMB"},
-    {465, "SMTPS"},
-    {514, "Syslog"},
-    {515, "LPD"},
-    {587, "SMTP-TLS"},
-    {636, "LDAPS"},
-    {993, "IMAPS"},
-    {995, "POP3S"},
-    {1080, "SOCKS"},
-    {1194, "OpenVPN"},
-    {1433, "MSSQL"},
-    {1521, "Oracle-DB"},
-    {1723, "PPTP"},
-    {2049, "NFS"},
-    {2375, "Docker"},
-    {2376, "Docker-TLS"},
-    {3000, "HTTP-Dev"},
-    {3306, "MySQL"},
-    {3389, "RDP"},
-    {4444, "Metasploit"},
-    {5000, "HTTP-Flask"},
-    {5432, "PostgreSQL"},
-    {5900, "VNC"},
-    {5985, "WinRM-HTTP"},
-    {5986, "WinRM-HTTPS"},
-    {6379, "Redis"},
-    {6443, "Kubernetes"},
-    {7001, "WebLogic"},
-    {8000, "HTTP-Alt"},
-    {8080, "HTTP-Proxy"},
-    {8443, "HTTPS-Alt"},
-    {8888, "Jupyter"},
-    {9000, "PHP-FPM"},
-    {9090, "Prometheus"},
-    {9200, "Elasticsearch"},
-    {9300, "Elasticsearch"},
-    {10250, "Kubelet"},
-    {27017, "MongoDB"},
-    {27018, "MongoDB"},
-    {50000, "SAP"},
+// Fallback when no services.bin / services.txt is found
+const std::vector<ServiceDb::Entry> BUILTIN_SERVICES = {
+    {21, "FTP", 0},
+    {22, "SSH", 0},
+    {23, "Telnet", 0},
+    {25, "SMTP", 0},
+    {53, "DNS", 0},
+    {67, "DHCP", 0},
+    {68, "DHCP", 0},
+    {69, "TFTP", 0},
+    {80, "HTTP", 0},
+    {110, "POP3", 0},
+    {111, "RPC", 0},
+    {119, "NNTP", 0},
+    {123, "NTP", 0},
+    {135, "MSRPC", 0},
+    {137, "NetBIOS", 0},
+    {138, "NetBIOS", 0},
+    {139, "NetBIOS-SSN", 0},
+    {143, "IMAP", 0},
+    {161, "SNMP", 0},
+    {179, "BGP", 0},
+    {194, "IRC", 0},
+    {389, "LDAP", 0},
+    {443, "HTTPS", 0},
+    {445, "SMB", 0},
+    {465, "SMTPS", 0},
+    {514, "Syslog", 0},
+    {515, "LPD", 0},
+    {587, "SMTP-TLS", 0},
+    {636, "LDAPS", 0},
+    {993, "IMAPS", 0},
+    {995, "POP3S", 0},
+    {1080, "SOCKS", 0},
+    {1194, "OpenVPN", 0},
+    {1433, "MSSQL", 0},
+    {1521, "Oracle-DB", 0},
+    {1723, "PPTP", 0},
+    {2049, "NFS", 0},
+    {2375, "Docker", 0},
+    {2376, "Docker-TLS", 0},
+    {3000, "HTTP-Dev", 0},
+    {3306, "MySQL", 0},
+    {3389, "RDP", 0},
+    {4444, "Metasploit", 0},
+    {5000, "HTTP-Flask", 0},
+    {5432, "PostgreSQL", 0},
+    {5900, "VNC", 0},
+    {5985, "WinRM-HTTP", 0},
+    {5986, "WinRM-HTTPS", 0},
+    {6379, "Redis", 0},
+    {6443, "Kubernetes", 0},
+    {7001, "WebLogic", 0},
+    {8000, "HTTP-Alt", 0},
+    {8080, "HTTP-Proxy", 0},
+    {8443, "HTTPS-Alt", 0},
+    {8888, "Jupyter", 0},
+    {9000, "PHP-FPM", 0},
+    {9090, "Prometheus", 0},
+    {9200, "Elasticsearch", 0},
+    {9300, "Elasticsearch", 0},
+    {10250, "Kubelet", 0},
+    {27017, "MongoDB", 0},
+    {27018, "MongoDB", 0},
+    {50000, "SAP", 0},
 };
 
+ServiceDb g_services;
+SimNetwork g_simNet; // answers probes for --engine sim / --sim
+FingerprintDb g_fingerprints; // empty when no rules file was found
+
 // ─────────────────────────────────────────────
 //  Scan Result Structure
 // ─────────────────────────────────────────────
 struct ScanResult {
+  std::string host;     // filled when the result is recorded
+  uint64_t hostIdx = 0; // index into ScanConfig::targets
+  uint64_t probeId = 0; // Probe::id, for checkpoints
   int port;
   bool open;
   long responseTimeMs;
-  std::string service;
+  net::ConnectStatus status = net::ConnectStatus::Error;
+  uint16_t serviceId; // ServiceDb ID, see g_services
   std::string banner;
+  std::string product; // fingerprint match: product, version, info
+  std::chrono::steady_clock::time_point postedAt; // handed to the reporter
 };
 
 // ─────────────────────────────────────────────
 //  Scanner Configuration
 // ─────────────────────────────────────────────
 struct ScanConfig {
-  std::string target;
-  std::string resolvedIP;
+  std::string target;     // target spec as given (display)
+  std::string resolvedIP; // address of the first host (display)
+  std::string targetFile; // -iL: one target spec per line
+  TargetSet targets;
   std::vector<int> ports;
   int timeout = 2000; // ms
   int threads = 100;
   bool grabBanner = true;
   bool verboseMode = false;
   std::string outputFile;
+  std::string jsonFile;   // -oJ: JSON Lines, written while scanning
+  std::string csvFile;    // -oC: CSV, written while scanning
+  std::string binaryFile; // -oB: binary records, written while scanning
+  std::string engine = "thread"; // thread | epoll | uring | syn | sim
+  std::string simProfile;        // --sim: simulated network profile
+  int inFlight = 4096;           // epoll/uring: outstanding connects
+  int reactors = 0;              // epoll/uring: 0 = one per core
+  int bannerConcurrency = 128;   // banners read at the same time
+  bool adaptive = true;          // AIMD window over connects in flight
+  double minRate = 0;            // probes/s floor (0 = none)
+  double maxRate = 0;            // probes/s ceiling (0 = none)
+  int retries = 1;               // extra passes over timed-out probes
+  bool randomize = false;        // shuffle (host, port) visiting order
+  uint64_t seed = 0;             // permutation seed for --randomize
+  int topPorts = 0;              // --top-ports: N likeliest ports, 0 = -p
+  bool freqOrder = true;         // likeliest-open ports first (--port-order)
+  std::string servicesFile;      // --services: explicit service database
+  std::string fingerprintsFile;  // --fingerprints: explicit rules file
+  std::string checkpointFile;    // --checkpoint: save progress here
+  std::string resumeFile;        // --resume: skip work done in this file
+  std::string metricsFile;       // --metrics: Prometheus text, every second
+  AsyncResolver::Options dns;    // --dns-server / --hosts-file / -4
+  std::string dnsCacheFile;      // --dns-cache: resolved names across runs
+  SocketManager::Options sockets; // --source-ip / --source-ports / ...
+  bool discovery = true;          // host liveness pre-pass (-Pn: off)
+  std::vector<int> pingPorts = // --ping-ports: probed by host discovery
+      {21, 22, 25, 80, 135, 139, 443, 445, 3389, 8080};
+  Shard shard;                       // --shard i/N: this process's slice
+  std::vector<std::string> mergeFiles; // --merge: shard checkpoints
 };
 
 // ─────────────────────────────────────────────
 //  Global State
 // ─────────────────────────────────────────────
-std::mutex g_printMtx;
-std::mutex g_resultMtx;
-std::vector<ScanResult> g_results;
-std::atomic<int> g_scanned(0);
-std::atomic<int> g_openCount(0);
-int g_totalPorts = 0;
+ResultStore g_results;     // open (+ filtered with -v), reporter-owned
+bool g_keepResults = true; // false when nothing reads g_results
+std::vector<std::unique_ptr<ResultStream>> g_streams; // -oJ / -oC / -oB
+Checkpoint *g_checkpoint = nullptr; // --checkpoint / --resume
+ScanMetrics g_metrics;                // phase latencies + connect counters
+std::string g_metricsFile;            // --metrics
+SocketManager g_sockets;              // probe sockets of every engine
+std::atomic<uint64_t> g_scanned(0);
+std::atomic<uint64_t> g_openCount(0);
+std::atomic<uint64_t> g_filteredCount(0); // still timed out after retries
+std::atomic<uint64_t> g_backoffs(0);      // congestion window halvings
+uint64_t g_retried = 0;                   // probes sent again after a timeout
+std::atomic<uint64_t> g_pinged(0);        // host discovery probes
+double g_finalWindow = 0;                 // window at the end of the sweep
+uint64_t g_totalProbes = 0;   // size of the (host, port) index space
+uint64_t g_plannedProbes = 0; // of those, probes of up hosts in the shard
+std::unique_ptr<ProbeSet> g_hostsUp; // host discovery; null = all hosts
+bool g_multiHost = false;
+std::chrono::steady_clock::time_point g_scanStarted;
+std::vector<uint32_t> g_openAtMs; // reporter-owned: when each open was found
 
 // ─────────────────────────────────────────────
 //  Enable ANSI in Windows Console
 // ─────────────────────────────────────────────
 void enableAnsiColors() {
+#ifdef _WIN32
   SetConsoleOutputCP(CP_UTF8);
   HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
   if (hOut != INVALID_HANDLE_VALUE) {
@@ -182,6 +266,7 @@ void enableAnsiColors() {
     dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
     SetConsoleMode(hOut, dwMode);
   }
+#endif
 }
 
 // ─────────────────────────────────────────────
@@ -219,7 +304,10 @@ void printHelp(const char *prog) {
   std::cout << "  " << prog << " <target> [options]\n\n";
 
   std::cout << Color::BWHITE << "ARGUMENTS:\n" << Color::RESET;
-  std::cout << "  <target>            Hostname or IP address to scan\n\n";
+  std::cout << "  <target>            Hostname, IP, CIDR or range, comma "
+               "separated\n";
+  std::cout << "                        10.0.0.1  10.0.0.0/16  "
+               "10.0.0.1-10.0.0.99  10.0.0.1-50\n\n";
 
   std::cout << Color::BWHITE << "OPTIONS:\n" << Color::RESET;
   std::cout << "  -p <ports>          Port specification (default: 1-1024)\n";
@@ -230,9 +318,81 @@ void printHelp(const char *prog) {
       << "  -t <threads>        Number of threads (default: 100, max: 500)\n";
   std::cout
       << "  -T <timeout>        Timeout in milliseconds (default: 2000)\n";
+  std::cout << "  -iL <file>          Read targets from file (one spec per "
+               "line)\n";
+  std::cout << "  --dns-server <ip>   Nameserver for target names, ip[:port]"
+               " (repeatable;\n"
+               "                      default: /etc/resolv.conf)\n";
+  std::cout << "  --dns-cache <file>  Keep resolved names across runs "
+               "(honours TTLs)\n";
+  std::cout << "  --hosts-file <file> Static names checked before DNS "
+               "(default: /etc/hosts)\n";
+  std::cout << "  -4                  Resolve target names to IPv4 only\n";
+  std::cout << "  --source-ip <a,b>    Bind probes to these source addresses "
+               "(rotating)\n";
+  std::cout << "  --source-ports <r>  Bind probes to source ports lo-hi "
+               "(rotating)\n";
+  std::cout << "  --syn-retries <n>   Kernel SYN retransmits per connect "
+               "(Linux, default: system)\n";
+  std::cout << "  -Pn                 Skip host discovery, scan every host\n";
+  std::cout << "  --ping-ports <p>    Ports probed for host discovery "
+               "(default:\n                      ";
+  std::vector<int> pingPorts = ScanConfig().pingPorts;
+  for (size_t i = 0; i < pingPorts.size(); i++)
+    std::cout << (i ? "," : "") << pingPorts[i];
+  std::cout << ")\n";
   std::cout << "  -o <file>           Save results to output file\n";
+  std::cout << "  -oJ <file>          Stream results as JSON Lines\n";
+  std::cout << "  -oC <file>          Stream results as CSV\n";
+  std::cout << "  -oB <file>          Stream results as binary records\n";
   std::cout << "  -v                  Verbose mode (show closed ports too)\n";
   std::cout << "  -nb                 No banner grabbing\n";
+  std::cout << "  --banner-conc <n>   Banners read concurrently (default: "
+               "128)\n";
+  std::cout << "  --engine <name>     Scan engine: thread (default) | epoll |"
+               " uring | syn | sim\n";
+  std::cout << "  -sS                 Raw SYN half-open scan (--engine syn;"
+               " Linux, root, IPv4,\n"
+               "                      no banners)\n";
+  std::cout << "  --sim <profile>     Scan a simulated network (--engine sim,"
+               " or thread)\n";
+  std::cout << "  --inflight <num>    epoll/uring: connects in flight "
+               "(default: 4096)\n";
+  std::cout << "  --reactors <num>    epoll/uring: event-loop threads "
+               "(default: 1 per core)\n";
+  std::cout << "  --min-rate <pps>    Keep at least this many probes/sec\n";
+  std::cout << "  --max-rate <pps>    Send at most this many probes/sec\n";
+  std::cout << "  --no-adaptive       Fixed concurrency (no congestion "
+               "control)\n";
+  std::cout << "  --retries <n>       Re-probe timed-out ports n times "
+               "(default: 1)\n";
+  std::cout << "  --top-ports <n>     Scan the n ports most often found open "
+               "(within -p if given)\n";
+  std::cout << "  --port-order <o>    freq (default): likeliest open first |"
+               " numeric\n";
+  std::cout << "  --randomize         Visit (host, port) pairs in random "
+               "order\n";
+  std::cout << "  --shard <i/N>       Scan only slice i of N of the job "
+               "(same args in every run)\n";
+  std::cout << "  --merge <ckpt...>   Combine the --checkpoint files of all "
+               "shards, check coverage\n";
+  std::cout << "  --seed <num>        Seed for --randomize (reproducible "
+               "order)\n";
+  std::cout << "  --services <file>   Service database (services.txt or "
+               ".bin)\n";
+  std::cout << "  --fingerprints <f>  Banner fingerprint rules (default: "
+               "fingerprints.txt)\n";
+  std::cout << "  --checkpoint <file> Save progress every 10s for "
+               "--resume\n";
+  std::cout << "  --resume <file>     Continue an interrupted scan from its "
+               "checkpoint\n";
+  std::cout << "  --metrics <file>    Write Prometheus metrics every second\n";
+  std::cout << "  --build-service-db <in> <out>\n";
+  std::cout << "                      Compile a services file to the "
+               "binary form\n";
+  std::cout << "  --update-freq <services.txt> <results...>\n";
+  std::cout << "                      Learn open-port frequencies from "
+               "-oJ/-oC/-oB files\n";
   std::cout << "  -h                  Show this help\n\n";
 
   std::cout << Color::BWHITE << "EXAMPLES:\n" << Color::RESET;
@@ -240,230 +400,264 @@ void printHelp(const char *prog) {
   std::cout << "  " << prog << " 192.168.1.1 -p 1-1024\n";
   std::cout << "  " << prog << " scanme.nmap.org -p 80,443,22 -t 50\n";
   std::cout << "  " << prog
-            << " 10.0.0.1 -p 1-65535 -t 500 -T 1000 -o results.txt\n\n";
+            << " 10.0.0.1 -p 1-65535 -t 500 -T 1000 -o results.txt\n";
+  std::cout << "  " << prog << " 10.0.0.1 -p 1-65535 --engine epoll\n";
+  std::cout << "  " << prog << " 10.0.0.0/16 -p 22,80,443 --engine epoll\n";
+  std::cout << "  " << prog << " 10.0.0.0/24 -p 1-1024 --max-rate 2000\n\n";
 }
 
 // ─────────────────────────────────────────────
 //  Progress Bar
 // ─────────────────────────────────────────────
-void printProgress() {
-  int scanned = g_scanned.load();
-  int total = g_totalPorts;
-  int open = g_openCount.load();
+// Rendered into one string so the reporter emits it with a single write
+std::string formatProgress() {
+  uint64_t scanned = g_scanned.load(std::memory_order_relaxed);
+  uint64_t total = g_plannedProbes;
+  uint64_t open = g_openCount.load(std::memory_order_relaxed);
 
   if (total == 0)
-    return;
+    return std::string();
 
-  float pct = (float)scanned / total;
+  float pct = (float)((double)scanned / (double)total);
   int fill = (int)(pct * 40);
 
-  std::lock_guard<std::mutex> lock(g_printMtx);
-  std::cout << "\r  " << Color::CYAN << "[";
+  std::ostringstream os;
+  os << "\r  " << Color::CYAN << "[";
   for (int i = 0; i < 40; i++)
-    std::cout << (i < fill ? "█" : "░");
-  std::cout << "] " << Color::BYELLOW << std::setw(3) << (int)(pct * 100) << "%"
-            << Color::RESET << " | Scanned: " << Color::WHITE << scanned << "/"
-            << total << Color::RESET << " | Open: " << Color::BGREEN << open
-            << Color::RESET << "   " << std::flush;
+    os << (i < fill ? "█" : "░");
+  os << "] " << Color::BYELLOW << std::setw(3) << (int)(pct * 100) << "%"
+     << Color::RESET << " | Scanned: " << Color::WHITE << scanned << "/"
+     << total << Color::RESET << " | Open: " << Color::BGREEN << open
+     << Color::RESET << "   ";
+  return os.str();
 }
 
 // ─────────────────────────────────────────────
-//  Resolve Hostname to IP
+//  Load Service Database
 // ─────────────────────────────────────────────
-std::string resolveHost(const std::string &host) {
-  struct addrinfo hints{}, *res = nullptr;
-  hints.ai_family = AF_INET;
-  hints.ai_socktype = SOCK_STREAM;
-
-  if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0)
-    return "";
-
-  char ipStr[INET_ADDRSTRLEN];
-  struct sockaddr_in *addr = (struct sockaddr_in *)res->ai_addr;
-  inet_ntop(AF_INET, &addr->sin_addr, ipStr, sizeof(ipStr));
-  freeaddrinfo(res);
-  return std::string(ipStr);
+// --services wins; otherwise services.bin, then services.txt, next to the
+// executable and then in the working directory; otherwise the built-in
+// list. Returns a description of what was loaded (empty on error).
+std::string loadServices(const std::string &explicitPath,
+                         const std::string &argv0, std::string &err) {
+  if (!explicitPath.empty())
+    return g_services.loadFile(explicitPath, err) ? explicitPath : "";
+
+  std::string exeDir;
+  size_t slash = argv0.find_last_of("/\\");
+  if (slash != std::string::npos)
+    exeDir = argv0.substr(0, slash + 1);
+
+  for (const std::string &dir : {exeDir, std::string()}) {
+    for (const char *file : {"services.bin", "services.txt"}) {
+      std::string path = dir + file;
+      std::ifstream probe(path);
+      if (probe.is_open() && g_services.loadFile(path, err))
+        return path;
+    }
+  }
+  g_services.loadEntries(BUILTIN_SERVICES);
+  return "built-in";
 }
 
 // ─────────────────────────────────────────────
-//  Grab Banner from Open Port
+//  Learn Port Frequencies
 // ─────────────────────────────────────────────
-std::string grabBanner(const std::string &ip, int port, int timeoutMs) {
-  SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (sock == INVALID_SOCKET)
-    return "";
-
-  DWORD timeout = (DWORD)timeoutMs;
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout,
-             sizeof(timeout));
-  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout,
-             sizeof(timeout));
-
-  struct sockaddr_in addr{};
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons((u_short)port);
-  inet_pton(AF_INET, ip.c_str(), &addr.sin_addr);
-
-  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
-    closesocket(sock);
-    return "";
+// --update-freq: fold the results of earlier scans (-oJ / -oC / -oB
+// files) into the frequencies of a services.txt. Each port becomes the
+// weighted mean of its current value, worth kPriorHosts hosts, and the
+// share of the scanned hosts that had it open; a host counts as scanned
+// when any record names it. Ports found open that the file does not list
+// are appended as "unknown". Returns the number of hosts learned from.
+uint64_t updateFrequencies(const std::string &path,
+                           const std::vector<std::string> &resultFiles,
+                           std::string &err) {
+  const double kPriorHosts = 1000;
+  std::unordered_set<std::string> hosts, openPairs;
+  std::vector<uint64_t> opens(65536, 0);
+  for (const std::string &file : resultFiles) {
+    bool ok = ResultReader::read(
+        file,
+        [&](const StreamRecord &r) {
+          hosts.insert(r.host);
+          if (r.state == 0 &&
+              openPairs.insert(r.host + " " + std::to_string(r.port)).second)
+            opens[(size_t)r.port]++;
+        },
+        err);
+    if (!ok)
+      return 0;
   }
-
-  // Send probe for HTTP
-  if (port == 80 || port == 8080 || port == 8000 || port == 8888) {
-    const char *req = "HEAD / HTTP/1.0\r\nHost: localhost\r\n\r\n";
-    send(sock, req, (int)strlen(req), 0);
+  if (hosts.empty()) {
+    err = "no results in the given files";
+    return 0;
   }
 
-  char buf[512] = {};
-  int received = recv(sock, buf, sizeof(buf) - 1, 0);
-  closesocket(sock);
-
-  if (received > 0) {
-    std::string banner(buf, received);
-    // Clean up: replace non-printable chars
-    std::string clean;
-    for (char c : banner) {
-      if (c == '\n' || c == '\r') {
-        clean += ' ';
-      } else if (c >= 32 && c < 127) {
-        clean += c;
-      }
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    err = "cannot open " + path;
+    return 0;
+  }
+  double n = (double)hosts.size();
+  auto blend = [&](double prior, int port) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%.6f",
+                  (prior * kPriorHosts + (double)opens[(size_t)port]) /
+                      (kPriorHosts + n));
+    return std::string(buf);
+  };
+  std::vector<bool> listed(65536, false);
+  std::string out, line;
+  while (std::getline(in, line)) {
+    size_t hash = line.find('#');
+    std::istringstream ls(line.substr(0, hash));
+    std::string name, portProto;
+    double freq = 0;
+    size_t slash;
+    if (!(ls >> name >> portProto) ||
+        (slash = portProto.find('/')) == std::string::npos ||
+        portProto.compare(slash + 1, std::string::npos, "tcp") != 0) {
+      out += line + "\n"; // comments, blank lines, other protocols
+      continue;
     }
-    // Trim
-    size_t end = clean.find_last_not_of(' ');
-    if (end != std::string::npos)
-      clean = clean.substr(0, end + 1);
-    if (clean.size() > 80)
-      clean = clean.substr(0, 80) + "...";
-    return clean;
+    ls >> freq;
+    int port = std::atoi(portProto.c_str());
+    if (port < 0 || port > 65535) {
+      out += line + "\n";
+      continue;
+    }
+    listed[(size_t)port] = true;
+    out += name + "\t" + portProto + "\t" + blend(freq, port);
+    if (hash != std::string::npos)
+      out += "\t" + line.substr(hash);
+    out += "\n";
   }
-  return "";
+  in.close();
+  for (int port = 1; port <= 65535; port++)
+    if (opens[(size_t)port] > 0 && !listed[(size_t)port])
+      out += "unknown\t" + std::to_string(port) + "/tcp\t" +
+             blend(0, port) + "\n";
+
+  std::string tmp = path + ".tmp";
+  std::ofstream ofs(tmp, std::ios::binary);
+  if (!(ofs << out) || (ofs.close(), !ofs) ||
+      std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    err = "cannot write " + path;
+    return 0;
+  }
+  return hosts.size();
 }
 
 // ─────────────────────────────────────────────
-//  Scan a Single Port
+//  Load Fingerprint Rules
 // ─────────────────────────────────────────────
-ScanResult scanPort(const std::string &ip, int port, const ScanConfig &cfg) {
-  ScanResult result;
-  result.port = port;
-  result.open = false;
-  result.banner = "";
-
-  // Service name lookup
-  auto it = SERVICES.find(port);
-  result.service = (it != SERVICES.end()) ? it->second : "unknown";
-
-  SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (sock == INVALID_SOCKET) {
-    result.responseTimeMs = -1;
-    return result;
+// --fingerprints wins; otherwise fingerprints.txt next to the executable,
+// then in the working directory. Without a rules file, banners are shown
+// but not classified. Returns where the rules came from ("" = none).
+std::string loadFingerprints(const std::string &explicitPath,
+                             const std::string &argv0, std::string &err) {
+  if (!explicitPath.empty())
+    return g_fingerprints.loadFile(explicitPath, err) ? explicitPath : "";
+
+  std::string exeDir;
+  size_t slash = argv0.find_last_of("/\\");
+  if (slash != std::string::npos)
+    exeDir = argv0.substr(0, slash + 1);
+
+  for (const std::string &dir : {exeDir, std::string()}) {
+    std::string path = dir + "fingerprints.txt";
+    std::ifstream probe(path);
+    if (probe.is_open())
+      return g_fingerprints.loadFile(path, err) ? path : "";
   }
+  return "";
+}
 
-  // Set non-blocking
-  u_long mode = 1;
-  ioctlsocket(sock, FIONBIO, &mode);
-
-  struct sockaddr_in addr{};
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons((u_short)port);
-  inet_pton(AF_INET, ip.c_str(), &addr.sin_addr);
-
-  auto startTime = std::chrono::steady_clock::now();
-  connect(sock, (struct sockaddr *)&addr, sizeof(addr));
-
-  // Use select() to wait
-  fd_set wset;
-  FD_ZERO(&wset);
-  FD_SET(sock, &wset);
-
-  struct timeval tv;
-  tv.tv_sec = cfg.timeout / 1000;
-  tv.tv_usec = (cfg.timeout % 1000) * 1000;
-
-  int sel = select(0, nullptr, &wset, nullptr, &tv);
-
-  auto endTime = std::chrono::steady_clock::now();
-  result.responseTimeMs =
-      std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime)
-          .count();
+// ─────────────────────────────────────────────
+//  Resolve Hostname to IP
+// ─────────────────────────────────────────────
+// Blocking, one name at a time; main() resolves target lists through
+// AsyncResolver instead
+std::vector<std::string> resolveHost(const std::string &host) {
+  return net::resolveAll(host, true);
+}
 
-  if (sel > 0 && FD_ISSET(sock, &wset)) {
-    // Verify connection actually succeeded
-    int error = 0;
-    int errLen = sizeof(error);
-    getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&error, &errLen);
-    if (error == 0) {
-      result.open = true;
-      g_openCount++;
+// ─────────────────────────────────────────────
+//  Sanitize Raw Banner Bytes
+// ─────────────────────────────────────────────
+std::string cleanBanner(const char *data, size_t len) {
+  // Clean up: replace non-printable chars
+  std::string clean;
+  for (size_t i = 0; i < len; i++) {
+    char c = data[i];
+    if (c == '\n' || c == '\r') {
+      clean += ' ';
+    } else if (c >= 32 && c < 127) {
+      clean += c;
     }
   }
+  // Trim
+  size_t end = clean.find_last_not_of(' ');
+  if (end != std::string::npos)
+    clean = clean.substr(0, end + 1);
+  if (clean.size() > 80)
+    clean = clean.substr(0, 80) + "...";
+  return clean;
+}
 
-  closesocket(sock);
-
-  // Grab banner if port is open
-  if (result.open && cfg.grabBanner) {
-    result.banner = grabBanner(ip, port, cfg.timeout / 2);
-  }
+// Attach a raw banner to a result: the printable form for display, and
+// the fingerprint (matched on the raw bytes) for service and version
+void applyBanner(ScanResult &res, const std::string &raw) {
+  if (raw.empty())
+    return;
+  res.banner = cleanBanner(raw.data(), raw.size());
 
-  return result;
+  Fingerprint fp;
+  if (!g_fingerprints.match(raw, fp))
+    return;
+  res.product = fp.product;
+  uint16_t id = g_services.find(fp.service);
+  if (id != ServiceDb::kUnknown)
+    res.serviceId = id;
 }
 
 // ─────────────────────────────────────────────
-//  Thread Worker
+//  Scan a Single Port
 // ─────────────────────────────────────────────
-class ThreadPool {
-public:
-  ThreadPool(size_t numThreads) : stop_(false) {
-    for (size_t i = 0; i < numThreads; i++) {
-      workers_.emplace_back([this] {
-        while (true) {
-          std::function<void()> task;
-          {
-            std::unique_lock<std::mutex> lock(mtx_);
-            cond_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
-            if (stop_ && tasks_.empty())
-              return;
-            task = std::move(tasks_.front());
-            tasks_.pop();
-          }
-          task();
-        }
-      });
-    }
-  }
+ScanResult newResult(int port) {
+  ScanResult result;
+  result.port = port;
+  result.open = false;
+  result.responseTimeMs = -1;
+  result.banner = "";
 
-  template <class F> void enqueue(F &&f) {
-    {
-      std::lock_guard<std::mutex> lock(mtx_);
-      tasks_.emplace(std::forward<F>(f));
-    }
-    cond_.notify_one();
-  }
+  // Service name lookup (flat table, no allocation)
+  result.serviceId = g_services.lookup(port);
+  return result;
+}
 
-  ~ThreadPool() {
-    {
-      std::lock_guard<std::mutex> lock(mtx_);
-      stop_ = true;
-    }
-    cond_.notify_all();
-    for (auto &w : workers_)
-      w.join();
-  }
+// When openSock is given and the port is open, the still-connected probe
+// socket is returned through it so the banner can be read on the same
+// connection (caller owns it).
+ScanResult scanPort(const net::Endpoint &ep, int port, int timeoutMs,
+                    net::socket_t *openSock = nullptr) {
+  ScanResult result = newResult(port);
 
-private:
-  std::vector<std::thread> workers_;
-  std::queue<std::function<void()>> tasks_;
-  std::mutex mtx_;
-  std::condition_variable cond_;
-  bool stop_;
-};
+  // Non-blocking connect, wait with select()/poll()
+  result.status =
+      g_sockets.connectTimed(ep, timeoutMs, result.responseTimeMs, openSock);
+  if (result.status == net::ConnectStatus::Open)
+    result.open = true;
+
+  return result;
+}
 
 // ─────────────────────────────────────────────
 //  Parse Port Specification
 // ─────────────────────────────────────────────
-std::vector<int> parsePorts(const std::string &spec) {
-  std::set<int> portSet;
+PortSet parsePorts(const std::string &spec) {
+  PortSet portSet;
   std::stringstream ss(spec);
   std::string token;
 
@@ -480,21 +674,43 @@ std::vector<int> parsePorts(const std::string &spec) {
         std::swap(lo, hi);
       lo = std::max(1, lo);
       hi = std::min(65535, hi);
-      for (int p = lo; p <= hi; p++)
-        portSet.insert(p);
+      if (lo <= hi)
+        portSet.addRange(lo, hi);
     } else {
       int p = std::stoi(token);
       if (p >= 1 && p <= 65535)
-        portSet.insert(p);
+        portSet.add(p);
     }
   }
-  return std::vector<int>(portSet.begin(), portSet.end());
+  return portSet;
+}
+
+// ─────────────────────────────────────────────
+//  Port Priority
+// ─────────────────────────────────────────────
+// Probes are generated port by port in cfg.ports order, so sorting the
+// ports by how often they are found open (services.txt frequencies) puts
+// most open ports at the front of a long sweep. --top-ports keeps the N
+// likeliest of the -p ports, or of all ports when -p is not given. Ports
+// without a frequency keep their numeric order behind the others.
+void prioritizePorts(ScanConfig &cfg, bool portsGiven) {
+  if (cfg.topPorts > 0 && !portsGiven)
+    cfg.ports = parsePorts("1-65535").toVector();
+  if (cfg.topPorts == 0 && !cfg.freqOrder)
+    return;
+  std::stable_sort(cfg.ports.begin(), cfg.ports.end(), [](int a, int b) {
+    return g_services.frequency(a) > g_services.frequency(b);
+  });
+  if (cfg.topPorts > 0 && (size_t)cfg.topPorts < cfg.ports.size())
+    cfg.ports.resize((size_t)cfg.topPorts);
+  if (!cfg.freqOrder)
+    std::sort(cfg.ports.begin(), cfg.ports.end());
 }
 
 // ─────────────────────────────────────────────
 //  Save Results to File
 // ─────────────────────────────────────────────
-void saveResults(const ScanConfig &cfg, const std::vector<ScanResult> &results,
+void saveResults(const ScanConfig &cfg, const ResultStore &results,
                  const std::string &startTime) {
   std::ofstream ofs(cfg.outputFile);
   if (!ofs.is_open()) {
@@ -507,30 +723,39 @@ void saveResults(const ScanConfig &cfg, const std::vector<ScanResult> &results,
   ofs << "TCP Port Scanner - Scan Report\n";
   ofs << "================================\n";
   ofs << "Target      : " << cfg.target << "\n";
-  ofs << "IP Address  : " << cfg.resolvedIP << "\n";
+  if (g_multiHost)
+    ofs << "Hosts       : " << cfg.targets.hostCount() << "\n";
+  else
+    ofs << "IP Address  : " << cfg.resolvedIP << "\n";
   ofs << "Scan Time   : " << startTime << "\n";
   ofs << "Total Ports : " << cfg.ports.size() << "\n";
   ofs << "Threads     : " << cfg.threads << "\n";
   ofs << "Timeout     : " << cfg.timeout << " ms\n";
   ofs << "\n";
-  ofs << "PORT      STATE     SERVICE      RESPONSE     BANNER\n";
-  ofs << "------    -----     -------      --------     ------\n";
-
-  for (const auto &r : results) {
-    if (!r.open)
-      continue;
-    ofs << std::left << std::setw(10) << r.port << std::setw(10) << "OPEN"
-        << std::setw(13) << r.service << std::setw(13)
-        << (std::to_string(r.responseTimeMs) + " ms") << r.banner << "\n";
-  }
+  if (g_multiHost)
+    ofs << std::left << std::setw(40) << "HOST";
+  ofs << "PORT      STATE     SERVICE      RESPONSE     VERSION"
+         "                                 BANNER\n";
+  if (g_multiHost)
+    ofs << std::left << std::setw(40) << "----";
+  ofs << "------    -----     -------      --------     -------"
+         "                                 ------\n";
+
+  results.forEach([&](const ResultStore::View &r) {
+    bool open = r.state == ResultStore::kOpen;
+    if (g_multiHost)
+      ofs << std::left << std::setw(40) << cfg.targets.hostString(r.hostIdx);
+    ofs << std::left << std::setw(10) << r.port << std::setw(10)
+        << (open ? "OPEN" : "FILTERED") << std::setw(13)
+        << g_services.name(r.serviceId) << std::setw(13)
+        << (open ? std::to_string(r.latencyMs) + " ms" : std::string("-"))
+        << std::setw(40) << r.product << r.banner << "\n";
+  });
 
   ofs << "\nScan Summary:\n";
-  int openCnt = 0;
-  for (const auto &r : results)
-    if (r.open)
-      openCnt++;
-  ofs << "  Open ports  : " << openCnt << "\n";
-  ofs << "  Total scanned: " << results.size() << "\n";
+  ofs << "  Open ports  : " << results.count(ResultStore::kOpen) << "\n";
+  ofs << "  Filtered    : " << g_filteredCount.load() << "\n";
+  ofs << "  Total scanned: " << g_scanned.load() << "\n";
 
   ofs.close();
   std::cout << Color::BGREEN << "\n  [✓] Results saved to: " << cfg.outputFile
@@ -538,42 +763,714 @@ void saveResults(const ScanConfig &cfg, const std::vector<ScanResult> &results,
 }
 
 // ─────────────────────────────────────────────
-//  Print Scan Table Row
+//  Format Scan Table Row
 // ─────────────────────────────────────────────
-void printOpenPort(const ScanResult &r) {
-  std::lock_guard<std::mutex> lock(g_printMtx);
-  // Move cursor to new line after progress bar
-  std::cout << "\r" << std::string(80, ' ') << "\r";
-  std::cout << "  " << Color::BGREEN << "[OPEN]" << Color::RESET << "  "
-            << Color::BWHITE << std::setw(6) << r.port << "/tcp" << Color::RESET
-            << "  " << Color::BCYAN << std::setw(14) << std::left << r.service
-            << Color::RESET << "  " << Color::YELLOW << std::setw(8)
-            << (std::to_string(r.responseTimeMs) + "ms") << Color::RESET;
+void formatOpenPort(std::ostream &os, const ScanResult &r) {
+  os << "  " << Color::BGREEN << "[OPEN]" << Color::RESET << "  ";
+  if (g_multiHost)
+    os << Color::BWHITE << r.host << ":" << Color::RESET;
+  os << Color::BWHITE << std::right << std::setw(6) << r.port << "/tcp"
+     << Color::RESET << "  " << Color::BCYAN << std::setw(14) << std::left
+     << g_services.name(r.serviceId) << Color::RESET << "  " << Color::YELLOW
+     << std::setw(8)
+     << (std::to_string(r.responseTimeMs) + "ms") << Color::RESET;
+
+  if (!r.product.empty()) {
+    os << "  " << Color::WHITE << "│ " << Color::MAGENTA << r.product
+       << Color::RESET;
+  } else if (!r.banner.empty()) {
+    os << "  " << Color::WHITE << "│ " << r.banner << Color::RESET;
+  }
+  os << "\n";
+}
+
+void formatClosedPort(std::ostream &os, const ScanResult &r) {
+  if (r.status == net::ConnectStatus::TimedOut)
+    os << "  " << Color::YELLOW << "[FLTR]" << Color::RESET << "  ";
+  else
+    os << "  " << Color::RED << "[CLSD]" << Color::RESET << "  ";
+  if (g_multiHost)
+    os << Color::WHITE << r.host << ":" << Color::RESET;
+  os << Color::WHITE << std::right << std::setw(6) << r.port << "/tcp"
+     << Color::RESET << "  " << Color::WHITE << std::setw(14) << std::left
+     << g_services.name(r.serviceId) << Color::RESET << "\n";
+}
 
-  if (!r.banner.empty()) {
-    std::cout << "  " << Color::WHITE << "│ " << r.banner << Color::RESET;
+// ─────────────────────────────────────────────
+//  Streaming Output
+// ─────────────────────────────────────────────
+// Open every requested stream; on failure err names the file
+bool openStreams(const ScanConfig &cfg, std::string &err) {
+  struct Want {
+    const std::string &path;
+    ResultStream *stream;
+  };
+  Want wants[] = {{cfg.jsonFile, new JsonLinesStream()},
+                  {cfg.csvFile, new CsvStream()},
+                  {cfg.binaryFile, new BinaryStream()}};
+  bool ok = true;
+  for (Want &w : wants) {
+    std::unique_ptr<ResultStream> stream(w.stream);
+    if (w.path.empty() || !ok)
+      continue;
+    if (!stream->open(w.path)) {
+      err = w.path;
+      ok = false;
+      continue;
+    }
+    g_streams.push_back(std::move(stream));
   }
-  std::cout << "\n";
+  return ok;
 }
 
-void printClosedPort(const ScanResult &r) {
-  std::lock_guard<std::mutex> lock(g_printMtx);
-  std::cout << "\r" << std::string(80, ' ') << "\r";
-  std::cout << "  " << Color::RED << "[CLSD]" << Color::RESET << "  "
-            << Color::WHITE << std::setw(6) << r.port << "/tcp" << Color::RESET
-            << "  " << Color::WHITE << std::setw(14) << std::left << r.service
-            << Color::RESET << "\n";
+void closeStreams() {
+  for (auto &s : g_streams)
+    s->close();
+  g_streams.clear();
+}
+
+// Truncate every stream back to its header (a scan that restarts must
+// not leave the first attempt's records ahead of the second's)
+bool rewindStreams(const ScanConfig &cfg, std::string &err) {
+  closeStreams();
+  return openStreams(cfg, err);
+}
+
+void streamResult(const ScanResult &r) {
+  if (g_streams.empty())
+    return;
+  StreamRecord rec;
+  rec.host = r.host;
+  rec.port = r.port;
+  rec.state = r.open ? 0 : r.status == net::ConnectStatus::TimedOut ? 2 : 1;
+  rec.rttMs = r.status == net::ConnectStatus::TimedOut ? -1 : r.responseTimeMs;
+  rec.service = g_services.name(r.serviceId);
+  rec.product = r.product;
+  rec.banner = r.banner;
+  for (auto &s : g_streams)
+    s->write(rec);
+}
+
+// ─────────────────────────────────────────────
+//  Metrics File
+// ─────────────────────────────────────────────
+// Rewritten whole through a temporary file, so a collector (e.g. the
+// node_exporter textfile collector) never reads a half-written one
+bool writeMetrics(const std::string &path) {
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    if (!out.is_open())
+      return false;
+    out << g_metrics.prometheus(g_scanned.load(std::memory_order_relaxed),
+                                g_plannedProbes)
+        << g_sockets.prometheus();
+    if (!out)
+      return false;
+  }
+  std::remove(path.c_str()); // rename() does not replace on Windows
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// ─────────────────────────────────────────────
+//  Reporter Thread
+// ─────────────────────────────────────────────
+// Sole owner of the console, g_results and the output streams while a
+// scan runs. Workers post rows through a lock-free queue; the reporter
+// prints and streams them in batches and redraws the progress bar at a
+// fixed refresh rate.
+class Reporter {
+public:
+  static constexpr int kRefreshMs = 100;
+  static constexpr int kCheckpointMs = 10000;
+  static constexpr int kMetricsMs = 1000;
+
+  void start() {
+    stop_ = false;
+    lastCheckpoint_ = lastMetrics_ = std::chrono::steady_clock::now();
+    thread_ = std::thread([this] { loop(); });
+  }
+
+  // Prints everything posted so far, then joins the thread
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  // Any thread; never blocks
+  void post(ScanResult res) {
+    res.postedAt = std::chrono::steady_clock::now();
+    queue_.push(std::move(res));
+  }
+
+private:
+  void loop() {
+    while (true) {
+      bool stopping;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait_for(lock, std::chrono::milliseconds(kRefreshMs),
+                       [this] { return stop_; });
+        stopping = stop_;
+      }
+      flush();
+      auto now = std::chrono::steady_clock::now();
+      if (g_checkpoint &&
+          (stopping || now - lastCheckpoint_ >=
+                           std::chrono::milliseconds(kCheckpointMs))) {
+        saveCheckpoint();
+        lastCheckpoint_ = now;
+      }
+      if (!g_metricsFile.empty() &&
+          (stopping ||
+           now - lastMetrics_ >= std::chrono::milliseconds(kMetricsMs))) {
+        writeMetrics(g_metricsFile);
+        lastMetrics_ = now;
+      }
+      if (stopping)
+        return;
+    }
+  }
+
+  void saveCheckpoint() {
+    std::string err;
+    if (g_checkpoint->save(err) || checkpointFailed_)
+      return;
+    checkpointFailed_ = true; // warn once
+    std::cout << "\r" << std::string(80, ' ') << "\r  " << Color::RED
+              << "[!] Checkpoint not saved: " << err << Color::RESET << "\n"
+              << std::flush;
+  }
+
+  void flush() {
+    std::ostringstream rows;
+    ScanResult r;
+    LatencyHistogram &reportWait = g_metrics.phase(ScanMetrics::kReport);
+    while (queue_.pop(r)) {
+      reportWait.recordSince(r.postedAt);
+      if (g_checkpoint) {
+        g_checkpoint->markDone(r.probeId,
+                               r.status == net::ConnectStatus::TimedOut);
+        if (r.open)
+          g_checkpoint->open().add(r.hostIdx, r.port, ResultStore::kOpen,
+                                   r.responseTimeMs, r.serviceId, r.banner,
+                                   r.product);
+      }
+      streamResult(r);
+      if (r.open) {
+        g_openAtMs.push_back(
+            (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                r.postedAt - g_scanStarted)
+                .count());
+        formatOpenPort(rows, r);
+        keep(r, ResultStore::kOpen);
+      } else {
+        formatClosedPort(rows, r);
+        if (r.status == net::ConnectStatus::TimedOut)
+          keep(r, ResultStore::kFiltered);
+      }
+    }
+
+    std::string out;
+    if (rows.tellp() > 0) // clear the progress line first
+      out = "\r" + std::string(80, ' ') + "\r" + rows.str();
+    out += formatProgress();
+    std::cout << out << std::flush;
+  }
+
+  static void keep(const ScanResult &r, ResultStore::State state) {
+    if (g_keepResults)
+      g_results.add(r.hostIdx, r.port, state, r.responseTimeMs, r.serviceId,
+                    r.banner, r.product);
+  }
+
+  MpscQueue<ScanResult> queue_;
+  std::mutex mtx_; // only guards stop_ (never taken by workers)
+  std::condition_variable cond_;
+  bool stop_ = false;
+  std::thread thread_;
+  std::chrono::steady_clock::time_point lastCheckpoint_;
+  std::chrono::steady_clock::time_point lastMetrics_;
+  bool checkpointFailed_ = false;
+};
+
+Reporter g_reporter;
+
+// ─────────────────────────────────────────────
+//  Record a Finished Port
+// ─────────────────────────────────────────────
+// Hot path: counters only, plus a queue push for rows that get printed
+void recordResult(const ScanConfig &cfg, uint64_t hostIdx, ScanResult res) {
+  g_scanned.fetch_add(1, std::memory_order_relaxed);
+  if (res.open)
+    g_openCount.fetch_add(1, std::memory_order_relaxed);
+  else if (res.status == net::ConnectStatus::TimedOut)
+    g_filteredCount.fetch_add(1, std::memory_order_relaxed);
+
+  // Only open ports are kept, so memory does not grow with probe count.
+  // Posted results are marked done by the reporter once it holds them.
+  if (res.open || cfg.verboseMode) {
+    res.host = cfg.targets.hostString(hostIdx);
+    res.hostIdx = hostIdx;
+    g_reporter.post(std::move(res));
+  } else if (g_checkpoint) {
+    g_checkpoint->markDone(res.probeId,
+                           res.status == net::ConnectStatus::TimedOut);
+  }
+}
+
+// ─────────────────────────────────────────────
+//  Scan Pass
+// ─────────────────────────────────────────────
+// One sweep over a generator. The first pass covers every probe; retry
+// passes revisit only the probes that timed out, with a doubled RTO.
+struct ScanPass {
+  ProbeGenerator &gen;
+  BannerStage *banners;
+  CongestionController &cc;
+  RttTable &rtt;
+  int backoff;     // RTO multiplier for this pass
+  ProbeSet *retry; // collects timeouts; null on the final pass
+};
+
+int probeTimeout(const ScanPass &pass, const Probe &p) {
+  return pass.rtt.timeoutFor(pass.gen.hostIndex(p), pass.backoff);
+}
+
+// Connect outcome as ScanMetrics counts it
+int metricsStatus(net::ConnectStatus s) {
+  switch (s) {
+  case net::ConnectStatus::Open:
+    return 0;
+  case net::ConnectStatus::Refused:
+    return 1;
+  case net::ConnectStatus::TimedOut:
+    return 2;
+  default:
+    return 3;
+  }
+}
+
+// Record a probe, first reading the banner on its open socket if any
+void finishProbe(const ScanConfig &cfg, uint64_t hostIdx, const ScanResult &res,
+                 net::socket_t sock, BannerStage *banners) {
+  if (sock != net::kInvalidSocket) {
+    if (banners) {
+      banners->submit(sock, res.port, [&cfg, hostIdx, res](std::string raw) {
+        ScanResult done = res;
+        applyBanner(done, raw);
+        recordResult(cfg, hostIdx, done);
+      });
+      return;
+    }
+    g_sockets.close(sock);
+  }
+  recordResult(cfg, hostIdx, res);
+}
+
+// Feed the RTT estimate, defer timeouts to the next pass, record the rest
+void completeProbe(const ScanConfig &cfg, ScanPass &pass, const Probe &p,
+                   const ScanResult &res, net::socket_t sock) {
+  uint64_t hostIdx = pass.gen.hostIndex(p);
+  if (res.status == net::ConnectStatus::Open ||
+      res.status == net::ConnectStatus::Refused) {
+    pass.rtt.sample(hostIdx, res.responseTimeMs);
+  } else if (res.status == net::ConnectStatus::TimedOut && pass.retry) {
+    pass.retry->set(p.id);
+    return;
+  }
+  finishProbe(cfg, hostIdx, res, sock, pass.banners);
+}
+
+// ─────────────────────────────────────────────
+//  Engine: one blocking connect per pool thread
+// ─────────────────────────────────────────────
+void runThreadScan(const ScanConfig &cfg, ScanPass &pass) {
+  int numThreads = (int)std::min<uint64_t>(cfg.threads, pass.gen.total());
+  WorkStealingPool pool(numThreads);
+
+  // Workers walk contiguous chunks of the probe index space and steal
+  // from each other when their own slice runs dry; the controller
+  // decides how many of them may connect at once.
+  uint64_t span = pass.gen.span();
+  uint64_t grain = std::max<uint64_t>(
+      1, std::min<uint64_t>(1024, span / ((uint64_t)numThreads * 16)));
+
+  pool.start(span, grain, [&cfg, &pass](int, const Chunk &chunk) {
+    Probe p;
+    LatencyHistogram &admit = g_metrics.phase(ScanMetrics::kAdmit);
+    for (uint64_t k = chunk.begin; k < chunk.end; k++) {
+      if (!pass.gen.at(k, p))
+        continue;
+      auto queued = std::chrono::steady_clock::now();
+      if (pass.banners)
+        pass.banners->waitForSpace();
+      uint64_t ticket = pass.cc.acquire();
+      admit.recordSince(queued);
+
+      g_metrics.connectStarted();
+      auto start = std::chrono::steady_clock::now();
+      net::socket_t sock = net::kInvalidSocket;
+      ScanResult res = scanPort(p.ep, p.port, probeTimeout(pass, p),
+                                pass.banners ? &sock : nullptr);
+      res.probeId = p.id;
+      g_metrics.connectDone(
+          metricsStatus(res.status),
+          (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count());
+
+      ProbeOutcome out;
+      out.status = res.status;
+      out.elapsedMs = res.responseTimeMs;
+      pass.cc.release(ticket, out);
+
+      completeProbe(cfg, pass, p, res, sock);
+    }
+  });
+  pool.wait();
+}
+
+// ─────────────────────────────────────────────
+//  Engines: epoll reactors / io_uring rings / raw SYN / simulation
+// ─────────────────────────────────────────────
+// Run an event engine over source/sink; false if it could not start
+// (e.g. io_uring disabled, no raw socket permission)
+bool runEngine(const std::string &engine, const EngineOptions &opts,
+               const ProbeSource &source, const ProbeSink &sink) {
+  if (engine == "sim") {
+    SimEngine(opts, g_simNet).run(source, sink);
+    return true;
+  }
+#ifdef __linux__
+  if (engine == "syn")
+    return SynEngine(opts).run(source, sink);
+  if (engine == "uring")
+    return UringEngine(opts).run(source, sink);
+  EpollEngine(opts).run(source, sink);
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Returns false if the engine could not start (e.g. io_uring disabled,
+// no raw socket permission)
+bool runEventScan(const ScanConfig &cfg, const std::string &engine,
+                  ScanPass &pass) {
+  // io_uring and the simulator deliver the banner with the outcome; epoll
+  // hands open sockets to the banner stage.
+  bool uring = engine == "uring";
+  bool sim = engine == "sim";
+
+  ProbeSource source = [&](Probe &p) {
+    if (!pass.gen.next(p))
+      return false;
+    p.timeoutMs = probeTimeout(pass, p);
+    g_metrics.connectStarted();
+    return true;
+  };
+
+  ProbeSink sink = [&](const Probe &p, const ProbeOutcome &out) {
+    g_metrics.connectDone(metricsStatus(out.status),
+                          (uint64_t)std::max(0LL, out.elapsedUs));
+    ScanResult res = newResult(p.port);
+    res.probeId = p.id;
+    res.responseTimeMs = out.elapsedMs;
+    res.status = out.status;
+    res.open = out.status == net::ConnectStatus::Open;
+    applyBanner(res, out.banner);
+    completeProbe(cfg, pass, p, res, out.sock);
+  };
+
+  EngineOptions opts;
+  opts.timeoutMs = cfg.timeout;
+  opts.reactors = cfg.reactors;
+  opts.maxInFlight = cfg.inFlight;
+  opts.grabBanner = cfg.grabBanner && (uring || sim);
+  opts.keepOpen = pass.banners != nullptr;
+  opts.bannerTimeoutMs = std::max(1, cfg.timeout / 2);
+  opts.throttle = &pass.cc;
+  opts.sockets = &g_sockets;
+  // Open sockets go to the banner stage from the sink, which must not
+  // wait: hold back new connects instead while its backlog is full
+  std::unique_ptr<BannerGate> gate;
+  if (pass.banners) {
+    gate.reset(new BannerGate(pass.cc, *pass.banners));
+    opts.throttle = gate.get();
+  }
+  return runEngine(engine, opts, source, sink);
 }
 
 // ─────────────────────────────────────────────
 //  Main Scanner Logic
 // ─────────────────────────────────────────────
+// Congestion controller sized for the engine's concurrency limit
+static std::unique_ptr<CongestionController>
+makeController(const ScanConfig &cfg, int capacity) {
+  CongestionController::Options o;
+  o.maxWindow = std::max(1, capacity);
+  o.initialWindow = std::max(16.0, o.maxWindow / 16);
+  o.minRate = cfg.minRate;
+  o.maxRate = cfg.maxRate;
+  o.adaptive = cfg.adaptive;
+  o.warmupMs = cfg.timeout;
+  return std::unique_ptr<CongestionController>(new CongestionController(o));
+}
+
+// Run one pass with `engine`; false if an event engine could not run
+bool runPass(const ScanConfig &cfg, const std::string &engine,
+             ProbeGenerator &gen, RttTable &rtt, int backoff,
+             ProbeSet *retry) {
+  // Banner stage for engines that hand over open probe sockets; finished
+  // (drained) before the pass returns.
+  std::unique_ptr<BannerStage> banners;
+  if (cfg.grabBanner && (engine == "thread" || engine == "epoll"))
+    banners.reset(new BannerStage(cfg.bannerConcurrency,
+                                  std::max(1, cfg.timeout / 2),
+                                  (size_t)cfg.bannerConcurrency * 8,
+                                  &g_sockets));
+  if (banners)
+    banners->setMetrics(&g_metrics.phase(ScanMetrics::kBannerQueue),
+                        &g_metrics.phase(ScanMetrics::kBannerRead));
+
+  auto cc = makeController(cfg, engine == "thread" ? cfg.threads : cfg.inFlight);
+  ScanPass pass{gen, banners.get(), *cc, rtt, backoff, retry};
+
+  bool ok = true;
+  if (engine != "thread")
+    ok = runEventScan(cfg, engine, pass);
+  else
+    runThreadScan(cfg, pass);
+
+  // The first pass is the sweep proper; retries only revisit timeouts
+  if (backoff == 1)
+    g_finalWindow = cc->window();
+  g_backoffs += cc->backoffs();
+  return ok;
+}
+
+// Ping probes (index space hosts x pingPorts) of the hosts this shard
+// owns any probe on; null when that is every host. Shard s owns port p
+// of a host when p = s - hostKey (mod N), so only the residues of the
+// port list mod N matter: with at least N consecutive ports every shard
+// owns every host, with fewer (e.g. -p 80 over 16 shards) each host is
+// pinged by the shards that scan it only.
+std::unique_ptr<ProbeSet> shardPings(const ScanConfig &cfg) {
+  const Shard &shard = cfg.shard;
+  if (shard.all())
+    return nullptr;
+  std::unordered_set<uint32_t> residues;
+  for (int port : cfg.ports)
+    residues.insert((uint32_t)port % shard.count);
+  if (residues.size() == shard.count)
+    return nullptr;
+
+  uint64_t hosts = cfg.targets.hostCount();
+  std::unique_ptr<ProbeSet> only(new ProbeSet(hosts * cfg.pingPorts.size()));
+  net::Endpoint ep;
+  for (uint64_t h = 0; h < hosts; h++) {
+    cfg.targets.endpoint(h, ep);
+    uint32_t key = (uint32_t)(Shard::hostKey(ep) % shard.count);
+    if (!residues.count((shard.index + shard.count - key) % shard.count))
+      continue;
+    for (size_t k = 0; k < cfg.pingPorts.size(); k++)
+      only->set(k * hosts + h);
+  }
+  return only;
+}
+
+// ─────────────────────────────────────────────
+//  Host Discovery
+// ─────────────────────────────────────────────
+// A sweep over many hosts would otherwise pay ports x timeout for every
+// dead one. First a few common ports are probed on every host with the
+// scan engine; an answer from the host itself (open, or refused with a
+// RST; an ICMP unreachable from a router does not count) marks it up and
+// seeds its RTT estimate, and once a host is up its remaining ping ports
+// are skipped. Only hosts that answered get the full port list. Returns
+// null when discovery does not apply (-Pn, a single host, or no more
+// ports to scan than to ping).
+std::unique_ptr<ProbeSet> discoverHosts(const ScanConfig &cfg,
+                                        RttTable &rtt) {
+  uint64_t hosts = cfg.targets.hostCount();
+  if (!cfg.discovery || hosts < 2 || cfg.pingPorts.empty() ||
+      cfg.ports.size() <= cfg.pingPorts.size())
+    return nullptr;
+
+  std::unique_ptr<ProbeSet> up(new ProbeSet(hosts));
+  std::unique_ptr<ProbeSet> only = shardPings(cfg);
+  ProbeGenerator gen(cfg.targets, cfg.pingPorts, only.get());
+  auto answered = [&](const Probe &p, const ProbeOutcome &out) {
+    g_pinged.fetch_add(1, std::memory_order_relaxed);
+    if (out.status != net::ConnectStatus::Open &&
+        (out.status != net::ConnectStatus::Refused || out.unreachable))
+      return;
+    uint64_t host = gen.hostIndex(p);
+    up->set(host);
+    rtt.sample(host, out.elapsedMs);
+  };
+
+  std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+            << " Host discovery   : " << Color::WHITE
+            << (only ? only->count() / cfg.pingPorts.size() : hosts)
+            << " hosts x " << cfg.pingPorts.size() << " ports ... "
+            << Color::RESET
+            << std::flush;
+  auto start = std::chrono::steady_clock::now();
+
+  bool done = false;
+  if (cfg.engine != "thread") {
+    auto cc = makeController(cfg, cfg.inFlight);
+    ProbeSource source = [&](Probe &p) {
+      while (gen.next(p))
+        if (!up->test(gen.hostIndex(p)))
+          return true;
+      return false;
+    };
+    ProbeSink sink = [&](const Probe &p, const ProbeOutcome &out) {
+      answered(p, out);
+    };
+    EngineOptions opts;
+    opts.timeoutMs = cfg.timeout;
+    opts.reactors = cfg.reactors;
+    opts.maxInFlight = cfg.inFlight;
+    opts.throttle = cc.get();
+    opts.sockets = &g_sockets;
+    done = runEngine(cfg.engine, opts, source, sink);
+  }
+  if (!done) {
+    // Thread engine, or the event engine could not start: the sweep
+    // falls back the same way
+    ProbeGenerator again(cfg.targets, cfg.pingPorts, only.get());
+    auto cc = makeController(cfg, cfg.threads);
+    int workers = (int)std::min<uint64_t>(cfg.threads, again.total());
+    WorkStealingPool pool(workers);
+    pool.start(again.span(), 64, [&](int, const Chunk &chunk) {
+      Probe p;
+      for (uint64_t k = chunk.begin; k < chunk.end; k++) {
+        if (!again.at(k, p) || up->test(again.hostIndex(p)))
+          continue;
+        uint64_t ticket = cc->acquire();
+        ProbeOutcome out;
+        int err = 0;
+        out.status = g_sockets.connectTimed(p.ep, cfg.timeout, out.elapsedMs,
+                                            nullptr, &err);
+        out.unreachable = net::unreachableError(err);
+        cc->release(ticket, out);
+        answered(p, out);
+      }
+    });
+    pool.wait();
+  }
+
+  long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  std::cout << Color::BGREEN << up->count() << " up" << Color::RESET << " ("
+            << ms << " ms)\n";
+  return up;
+}
+
+// Identifies the probe space a checkpoint belongs to: same targets, same
+// port set (the checkpoint maps its own port order onto cfg.ports).
+// Timing options may change between runs. ordered = also the port order,
+// as PSCKPT01/02 files were stamped.
+uint64_t checkpointHash(const ScanConfig &cfg, bool ordered = false) {
+  uint64_t h = 14695981039346656037ull; // FNV-1a
+  auto mix = [&h](const void *data, size_t len) {
+    for (size_t i = 0; i < len; i++)
+      h = (h ^ ((const unsigned char *)data)[i]) * 1099511628211ull;
+  };
+  mix(cfg.target.data(), cfg.target.size());
+  uint64_t hosts = cfg.targets.hostCount();
+  mix(&hosts, sizeof(hosts));
+  std::vector<int> ports = cfg.ports;
+  if (!ordered)
+    std::sort(ports.begin(), ports.end());
+  for (int port : ports)
+    mix(&port, sizeof(port));
+  return h;
+}
+
+// Open port saved in a checkpoint, as the reporter takes it
+ScanResult checkpointResult(const ScanConfig &cfg,
+                            const ResultStore::View &v) {
+  ScanResult res = newResult(v.port);
+  res.open = true;
+  res.status = net::ConnectStatus::Open;
+  res.responseTimeMs = v.latencyMs;
+  res.serviceId = v.serviceId;
+  res.banner = v.banner;
+  res.product = v.product;
+  res.hostIdx = v.hostIdx;
+  res.host = cfg.targets.hostString(v.hostIdx);
+  return res;
+}
+
+// Replay a loaded checkpoint: its open ports go back through the
+// reporter (so they are printed, streamed and saved again) and the
+// returned set holds the probes still to do. Null without a checkpoint.
+std::unique_ptr<ProbeSet> restoreCheckpoint(const ScanConfig &cfg) {
+  if (!g_checkpoint || g_checkpoint->done().count() == 0)
+    return nullptr;
+
+  uint64_t hosts = cfg.targets.hostCount();
+  uint64_t restored = 0;
+  std::vector<uint32_t> portIdx(65536, 0); // cfg.ports is not sorted
+  for (size_t i = 0; i < cfg.ports.size(); i++)
+    portIdx[(size_t)cfg.ports[i]] = (uint32_t)i;
+  g_checkpoint->open().forEach([&](const ResultStore::View &v) {
+    ScanResult res = checkpointResult(cfg, v);
+    res.probeId = portIdx[v.port] * hosts + v.hostIdx;
+    g_reporter.post(std::move(res));
+    restored++;
+  });
+  g_checkpoint->open().clear(); // refilled as the reporter takes them back
+
+  g_scanned = g_checkpoint->done().count();
+  g_openCount = restored;
+  g_filteredCount = g_checkpoint->filtered();
+
+  std::unique_ptr<ProbeSet> todo(new ProbeSet(g_totalProbes));
+  todo->assignComplement(g_checkpoint->done());
+  // Host discovery may find other hosts up than the earlier run did:
+  // plan what is left of this run's probes plus everything already done,
+  // so the progress bar ends at 100%
+  g_plannedProbes = ProbeGenerator(cfg.targets, cfg.ports, todo.get(),
+                                   nullptr, g_hostsUp.get(), cfg.shard)
+                        .total() +
+                    g_scanned;
+  return todo;
+}
+
 void runScan(const ScanConfig &cfg) {
-  g_totalPorts = (int)cfg.ports.size();
   g_scanned = 0;
   g_openCount = 0;
+  g_filteredCount = 0;
+  g_backoffs = 0;
+  g_retried = 0;
+  g_pinged = 0;
   g_results.clear();
-  g_results.resize(g_totalPorts);
+  g_metrics.reset();
+  g_sockets.resetStats();
+  g_openAtMs.clear();
+  g_scanStarted = std::chrono::steady_clock::now();
+  g_multiHost = cfg.targets.hostCount() > 1;
+  g_totalProbes = cfg.targets.hostCount() * cfg.ports.size();
+
+  RttTable rtt(cfg.timeout);
+  g_hostsUp = discoverHosts(cfg, rtt);
+  g_plannedProbes = ProbeGenerator(cfg.targets, cfg.ports, nullptr, nullptr,
+                                   g_hostsUp.get(), cfg.shard)
+                        .total();
+  if (g_checkpoint)
+    g_checkpoint->setHostsUp(g_hostsUp.get());
 
   // Table header
   std::cout << "\n";
@@ -585,48 +1482,99 @@ void runScan(const ScanConfig &cfg) {
       << "  ----------------------------------------------------------------\n"
       << Color::RESET;
 
-  int numThreads = std::min(cfg.threads, g_totalPorts);
-  ThreadPool pool(numThreads);
-
-  std::mutex idxMtx;
-
-  for (int i = 0; i < g_totalPorts; i++) {
-    int port = cfg.ports[i];
-    int idx = i;
-    pool.enqueue([&cfg, port, idx]() {
-      ScanResult res = scanPort(cfg.resolvedIP, port, cfg);
-      g_scanned++;
-
-      {
-        std::lock_guard<std::mutex> lock(g_resultMtx);
-        g_results[idx] = res;
-      }
-
-      if (res.open) {
-        printOpenPort(res);
-      } else if (cfg.verboseMode) {
-        printClosedPort(res);
+  // Probes that timed out last pass (or, when resuming, not yet done)
+  std::unique_ptr<ProbeSet> pending = restoreCheckpoint(cfg);
+  g_reporter.start();
+
+  std::string engine = cfg.engine;
+
+  // Same shuffled order for the sweep and its retry passes
+  std::unique_ptr<FeistelPermutation> order;
+  if (cfg.randomize)
+    order.reset(new FeistelPermutation(g_totalProbes, cfg.seed));
+
+  for (int attempt = 0; attempt <= cfg.retries; attempt++) {
+    bool last = attempt == cfg.retries;
+    // Nothing answered at all: the targets are silent, a retry would only
+    // repeat the full timeout without a better estimate
+    if (attempt > 0 && !rtt.hasSamples())
+      break;
+    ProbeGenerator gen(cfg.targets, cfg.ports, pending.get(), order.get(),
+                       g_hostsUp.get(), cfg.shard);
+    if (gen.total() == 0)
+      break;
+
+    std::unique_ptr<ProbeSet> timedOut;
+    if (!last)
+      timedOut.reset(new ProbeSet(gen.span()));
+    if (attempt > 0)
+      g_retried += gen.total();
+
+    if (!runPass(cfg, engine, gen, rtt, 1 << attempt, timedOut.get())) {
+      g_reporter.stop();
+      std::cerr << Color::RED << "\n  [!] " << engine
+                << " engine failed, finishing with thread engine"
+                << (engine == "syn" ? " (raw sockets need root or "
+                                      "CAP_NET_RAW)"
+                                    : "")
+                << "\n"
+                << Color::RESET;
+      engine = "thread";
+      if (g_checkpoint) {
+        // The done bits (a --resume's included) cover every probe the
+        // counters and streams already hold: carry on from them
+        pending.reset(new ProbeSet(g_totalProbes));
+        pending->assignComplement(g_checkpoint->done());
+        attempt = -1;
+        g_reporter.start();
+        continue;
       }
+      // Nothing records which probes finished: rescan from scratch
+      std::string streamErr;
+      if (!rewindStreams(cfg, streamErr))
+        std::cerr << Color::RED << "  [!] Cannot reopen output file: "
+                  << streamErr << "\n"
+                  << Color::RESET;
+      g_scanned = 0;
+      g_openCount = 0;
+      g_filteredCount = 0;
+      g_backoffs = 0;
+      g_retried = 0;
+      g_results.clear();
+      g_metrics.reset();
+      g_sockets.resetStats();
+      pending.reset();
+      attempt = -1;
+      g_reporter.start();
+      continue;
+    }
+    pending = std::move(timedOut);
+  }
 
-      printProgress();
-    });
+  // Timeouts left over when the retries stopped early are final
+  if (pending) {
+    ProbeGenerator gen(cfg.targets, cfg.ports, pending.get(), nullptr,
+                       g_hostsUp.get(), cfg.shard);
+    Probe p;
+    while (gen.next(p)) {
+      ScanResult res = newResult(p.port);
+      res.probeId = p.id;
+      res.status = net::ConnectStatus::TimedOut;
+      recordResult(cfg, gen.hostIndex(p), res);
+    }
   }
 
-  // Wait for all tasks to finish (pool destructor joins all threads)
+  g_reporter.stop();
 }
 
 // ─────────────────────────────────────────────
 //  Print Final Summary
 // ─────────────────────────────────────────────
-void printSummary(const ScanConfig &cfg, long long elapsedMs) {
-  int openCnt = 0;
-  int closedCnt = 0;
-  for (const auto &r : g_results) {
-    if (r.open)
-      openCnt++;
-    else
-      closedCnt++;
-  }
+void printSummary(const ScanConfig &cfg, long long elapsedMs,
+                  long long cpuMs) {
+  uint64_t openCnt = g_openCount.load();
+  uint64_t filteredCnt = g_filteredCount.load();
+  uint64_t closedCnt = g_scanned.load() - openCnt - filteredCnt;
 
   std::cout << "\n\n";
   std::cout
@@ -638,25 +1586,242 @@ void printSummary(const ScanConfig &cfg, long long elapsedMs) {
             << Color::RESET;
   std::cout << "  |  " << Color::CYAN << "Target        : " << Color::RESET
             << std::left << std::setw(26) << cfg.target << "|\n";
-  std::cout << "  |  " << Color::CYAN << "IP Address    : " << Color::RESET
-            << std::left << std::setw(26) << cfg.resolvedIP << "|\n";
+  if (g_multiHost)
+    std::cout << "  |  " << Color::CYAN << "Hosts         : " << Color::RESET
+              << std::left << std::setw(26)
+              << (std::to_string(cfg.targets.hostCount()) +
+                  (g_hostsUp ? " (" + std::to_string(g_hostsUp->count()) +
+                                   " up)"
+                             : std::string()))
+              << "|\n";
+  else
+    std::cout << "  |  " << Color::CYAN << "IP Address    : " << Color::RESET
+              << std::left << std::setw(26) << cfg.resolvedIP << "|\n";
   std::cout << "  |  " << Color::CYAN << "Ports Scanned : " << Color::RESET
-            << std::left << std::setw(26) << g_totalPorts << "|\n";
+            << std::left << std::setw(26) << g_plannedProbes << "|\n";
   std::cout << "  |  " << Color::BGREEN << "Open Ports    : " << Color::RESET
             << std::left << std::setw(26) << openCnt << "|\n";
   std::cout << "  |  " << Color::RED << "Closed Ports  : " << Color::RESET
             << std::left << std::setw(26) << closedCnt << "|\n";
+  std::cout << "  |  " << Color::YELLOW << "Filtered      : " << Color::RESET
+            << std::left << std::setw(26)
+            << (std::to_string(filteredCnt) + " (" +
+                std::to_string(g_retried) + " retried)")
+            << "|\n";
   std::cout << "  |  " << Color::YELLOW << "Duration      : " << Color::RESET
             << std::left << std::setw(26)
-            << (std::to_string(elapsedMs / 1000) + "." +
-                std::to_string(elapsedMs % 1000) + "s")
+            << ([elapsedMs] {
+                 char buf[32]; // 59 ms is 0.059s, not 0.59s
+                 std::snprintf(buf, sizeof(buf), "%lld.%03llds",
+                               elapsedMs / 1000, elapsedMs % 1000);
+                 return std::string(buf);
+               }())
             << "|\n";
+
+  // Engine comparison figures: connects/sec and CPU time per 10k ports
+  long long rate =
+      elapsedMs > 0 ? (long long)(g_plannedProbes * 1000 / elapsedMs) : 0;
+  long long cpuPer10k =
+      g_plannedProbes > 0 ? (long long)(cpuMs * 10000 / g_plannedProbes) : 0;
+  std::cout << "  |  " << Color::YELLOW << "Rate          : " << Color::RESET
+            << std::left << std::setw(26)
+            << (std::to_string(rate) + " ports/s") << "|\n";
+  std::cout << "  |  " << Color::YELLOW << "CPU / 10k     : " << Color::RESET
+            << std::left << std::setw(26)
+            << (std::to_string(cpuPer10k) + " ms (" + cfg.engine + ")")
+            << "|\n";
+  if (cfg.adaptive)
+    std::cout << "  |  " << Color::YELLOW << "Window        : " << Color::RESET
+              << std::left << std::setw(26)
+              << (std::to_string((long long)g_finalWindow) + " (" +
+                  std::to_string(g_backoffs.load()) + " backoffs)")
+              << "|\n";
   std::cout << "  +=========================================+\n\n";
+
+  // Where the time went: one row per pipeline phase that saw samples
+  std::cout << Color::BWHITE << "  PHASE              COUNT       p50       p90"
+            << "       p99       max" << Color::RESET << "\n";
+  for (int p = 0; p < ScanMetrics::kPhaseCount; p++) {
+    const LatencyHistogram &h = g_metrics.phase((ScanMetrics::Phase)p);
+    if (h.count() == 0)
+      continue;
+    std::cout << "  " << Color::CYAN << std::left << std::setw(14)
+              << ScanMetrics::phaseName(p) << Color::RESET << std::right
+              << std::setw(10) << h.count();
+    for (uint64_t v : {h.percentile(50), h.percentile(90), h.percentile(99),
+                       h.max()})
+      std::cout << std::setw(10) << ScanMetrics::formatUs(v);
+    std::cout << "\n";
+  }
+  std::cout << "  " << Color::WHITE << "Connects: " << g_metrics.refused()
+            << " refused, " << g_metrics.timedOut() << " timed out, "
+            << g_metrics.errors() << " socket errors" << Color::RESET << "\n";
+  if (!g_openAtMs.empty()) {
+    // Arrival order is what --port-order changes; report how early the
+    // open ports turned up rather than only when the sweep finished
+    std::vector<uint32_t> at = g_openAtMs;
+    std::sort(at.begin(), at.end());
+    std::cout << "  " << Color::WHITE << "Open    : first after " << at[0]
+              << " ms, 90% after " << at[(at.size() * 9 + 9) / 10 - 1]
+              << " ms, all after " << at.back() << " ms" << Color::RESET
+              << "\n";
+  }
+  std::cout << "  " << Color::WHITE << "Sockets : " << g_sockets.peak()
+            << " open at peak (budget " << g_sockets.budget() << "), "
+            << g_sockets.stalls() << " stalls for descriptors / source ports"
+            << Color::RESET << "\n\n";
+}
+
+// ─────────────────────────────────────────────
+//  Merge Shards
+// ─────────────────────────────────────────────
+// --merge: combine the checkpoints of a job split with --shard (every run
+// with the same targets and ports, and --checkpoint) into one report.
+// Each probe of the job must have been finished by the shard that owns
+// it, or belong to a host that shard found down; anything else is listed
+// as missing and the exit status is 2. Open ports go through the
+// reporter, so they are printed, streamed and saved as after a scan.
+int mergeShards(const ScanConfig &cfg) {
+  uint64_t hosts = cfg.targets.hostCount();
+  uint64_t span = hosts * cfg.ports.size();
+  std::vector<std::unique_ptr<Checkpoint>> shards;
+  for (const std::string &path : cfg.mergeFiles) {
+    std::unique_ptr<Checkpoint> ck(
+        new Checkpoint(path, hosts, cfg.ports, checkpointHash(cfg),
+                       checkpointHash(cfg, true)));
+    std::string err;
+    if (!ck->load(path, err)) {
+      std::cerr << Color::RED << "  [!] Cannot merge: " << err << "\n"
+                << Color::RESET;
+      return 1;
+    }
+    shards.push_back(std::move(ck));
+  }
+
+  // Exactly one checkpoint per shard slot, all from the same split
+  Shard split;
+  split.count = shards[0]->shard().count;
+  std::vector<const Checkpoint *> bySlot(split.count, nullptr);
+  for (const auto &ck : shards) {
+    const Shard &sh = ck->shard();
+    if (sh.count != split.count || bySlot[sh.index]) {
+      std::cerr << Color::RED << "  [!] Cannot merge: " << ck->path()
+                << " is shard " << sh.index + 1 << "/" << sh.count
+                << (sh.count != split.count ? ", a different split"
+                                            : ", given twice")
+                << "\n"
+                << Color::RESET;
+      return 1;
+    }
+    bySlot[sh.index] = ck.get();
+  }
+
+  // Coverage, over the whole probe space
+  uint64_t scanned = 0, down = 0, missing = 0, finished = 0;
+  std::vector<std::string> samples; // first few missing host:port
+  ProbeGenerator all(cfg.targets, cfg.ports);
+  Probe p;
+  while (all.next(p)) {
+    uint64_t host = all.hostIndex(p);
+    const Checkpoint *ck = bySlot[split.of(p.ep, p.port)];
+    if (ck && ck->done().test(p.id)) {
+      scanned++;
+    } else if (ck && ck->hostsUp() && !ck->hostsUp()->test(host)) {
+      down++;
+    } else if (missing++ < 5) {
+      samples.push_back(cfg.targets.hostString(host) + ":" +
+                        std::to_string(p.port));
+    }
+  }
+  for (const auto &ck : shards)
+    finished += ck->done().count();
+
+  std::string streamErr;
+  if (!openStreams(cfg, streamErr)) {
+    std::cerr << Color::RED << "  [!] Cannot open output file: " << streamErr
+              << "\n"
+              << Color::RESET;
+    closeStreams();
+    return 1;
+  }
+  g_multiHost = hosts > 1;
+  g_keepResults = !cfg.outputFile.empty();
+  g_results.clear();
+  g_plannedProbes = 0; // no progress bar
+
+  std::cout << "\n"
+            << Color::BWHITE
+            << "  PORT        SERVICE         LATENCY   BANNER\n"
+            << Color::RESET << Color::WHITE
+            << "  ----------------------------------------------------------"
+               "------\n"
+            << Color::RESET;
+  uint64_t open = 0, filtered = 0;
+  net::Endpoint ep;
+  g_reporter.start();
+  for (const auto &ck : shards) {
+    ck->open().forEach([&](const ResultStore::View &v) {
+      cfg.targets.endpoint(v.hostIdx, ep);
+      if (split.of(ep, v.port) != ck->shard().index)
+        return; // not this shard's probe; its owner reports it
+      g_reporter.post(checkpointResult(cfg, v));
+      open++;
+    });
+    filtered += ck->filtered();
+  }
+  g_reporter.stop();
+  closeStreams();
+  g_openCount = open;
+  g_filteredCount = filtered;
+  g_scanned = scanned;
+
+  std::cout << "\n  " << Color::CYAN << "[*]" << Color::RESET
+            << " Shards           : " << Color::WHITE << shards.size() << "/"
+            << split.count << " merged, " << open << " open ports"
+            << Color::RESET << "\n";
+  if (finished > scanned)
+    std::cout << "  " << Color::YELLOW << "[!]" << Color::RESET
+              << " Overlap          : " << finished - scanned
+              << " probes finished by a shard that does not own them\n";
+  if (missing == 0) {
+    std::cout << "  " << Color::BGREEN << "[✓]" << Color::RESET
+              << " Coverage         : " << Color::WHITE << span << "/" << span
+              << " probes (" << scanned << " scanned, " << down
+              << " on hosts down)" << Color::RESET << "\n";
+  } else {
+    std::cout << "  " << Color::RED << "[!]" << Color::RESET
+              << " Coverage         : " << Color::WHITE << span - missing
+              << "/" << span << " probes, " << missing << " missing (";
+    for (size_t i = 0; i < samples.size(); i++)
+      std::cout << (i ? ", " : "") << samples[i];
+    std::cout << (missing > samples.size() ? ", ..." : "") << ")"
+              << Color::RESET << "\n";
+    for (uint32_t i = 0; i < split.count; i++)
+      if (!bySlot[i])
+        std::cout << "  " << Color::RED << "[!]" << Color::RESET
+                  << " Shard " << i + 1 << "/" << split.count
+                  << " checkpoint not given\n";
+  }
+
+  if (!cfg.outputFile.empty()) {
+    auto nowT = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    char timeBuf[64];
+    struct tm tmInfo;
+    net::localTime(nowT, tmInfo);
+    strftime(timeBuf, sizeof(timeBuf), "%Y-%m-%d %H:%M:%S", &tmInfo);
+    saveResults(cfg, g_results, timeBuf);
+  }
+  std::cout << "\n";
+  return missing == 0 ? 0 : 2;
 }
 
 // ─────────────────────────────────────────────
 //  MAIN
 // ─────────────────────────────────────────────
+// Benchmarks include this file with PORT_SCANNER_NO_MAIN to drive the
+// scanner's internals directly.
+#ifndef PORT_SCANNER_NO_MAIN
 int main(int argc, char *argv[]) {
   enableAnsiColors();
   printBanner();
@@ -668,56 +1833,364 @@ int main(int argc, char *argv[]) {
 
   // ── Parse Args ──
   ScanConfig cfg;
-  cfg.target = argv[1];
   std::string portSpec = "1-1024"; // default
+  std::string pingSpec; // --ping-ports, empty = ScanConfig default
+  bool portsGiven = false;
+  bool seeded = false;
+  bool engineGiven = false; // --sim picks the sim engine unless told
 
-  for (int i = 2; i < argc; i++) {
+  for (int i = 1; i < argc; i++) {
     std::string arg = argv[i];
-    if ((arg == "-p") && i + 1 < argc) {
+    if (i == 1 && arg[0] != '-') {
+      cfg.target = arg;
+    } else if ((arg == "-iL") && i + 1 < argc) {
+      cfg.targetFile = argv[++i];
+    } else if ((arg == "-p") && i + 1 < argc) {
       portSpec = argv[++i];
+      portsGiven = true;
+    } else if (arg == "--top-ports" && i + 1 < argc) {
+      cfg.topPorts = std::max(1, std::min(std::stoi(argv[++i]), 65535));
+    } else if (arg == "--port-order" && i + 1 < argc) {
+      cfg.freqOrder = std::string(argv[++i]) != "numeric";
     } else if ((arg == "-t") && i + 1 < argc) {
       cfg.threads = std::min(std::stoi(argv[++i]), 500);
     } else if ((arg == "-T") && i + 1 < argc) {
       cfg.timeout = std::stoi(argv[++i]);
+    } else if (arg == "--dns-server" && i + 1 < argc) {
+      cfg.dns.servers.push_back(argv[++i]);
+    } else if (arg == "--dns-cache" && i + 1 < argc) {
+      cfg.dnsCacheFile = argv[++i];
+    } else if (arg == "--hosts-file" && i + 1 < argc) {
+      cfg.dns.hostsFile = argv[++i];
+    } else if (arg == "-4") {
+      cfg.dns.ipv6 = false;
+    } else if (arg == "--source-ip" && i + 1 < argc) {
+      std::stringstream ss(argv[++i]);
+      std::string addr;
+      while (std::getline(ss, addr, ','))
+        if (!addr.empty())
+          cfg.sockets.sourceAddrs.push_back(addr);
+    } else if (arg == "--source-ports" && i + 1 < argc) {
+      std::string range = argv[++i];
+      size_t dash = range.find('-');
+      cfg.sockets.portLo = std::stoi(range.substr(0, dash));
+      cfg.sockets.portHi = dash == std::string::npos
+                               ? cfg.sockets.portLo
+                               : std::stoi(range.substr(dash + 1));
+    } else if (arg == "--syn-retries" && i + 1 < argc) {
+      cfg.sockets.synRetries =
+          std::max(0, std::min(std::stoi(argv[++i]), 255));
+    } else if (arg == "-Pn") {
+      cfg.discovery = false;
+    } else if (arg == "--ping-ports" && i + 1 < argc) {
+      pingSpec = argv[++i];
+    } else if (arg == "--shard" && i + 1 < argc) {
+      std::string spec = argv[++i];
+      size_t slash = spec.find('/');
+      int index = std::atoi(spec.c_str());
+      int count = slash == std::string::npos
+                      ? 0
+                      : std::atoi(spec.c_str() + slash + 1);
+      if (index < 1 || count < 1 || index > count) {
+        std::cerr << Color::RED << "  [!] Bad --shard (want i/N, 1 <= i <= N): "
+                  << spec << "\n"
+                  << Color::RESET;
+        return 1;
+      }
+      cfg.shard.index = (uint32_t)(index - 1);
+      cfg.shard.count = (uint32_t)count;
+    } else if (arg == "--merge" && i + 1 < argc) {
+      while (i + 1 < argc && argv[i + 1][0] != '-')
+        cfg.mergeFiles.push_back(argv[++i]);
     } else if ((arg == "-o") && i + 1 < argc) {
       cfg.outputFile = argv[++i];
+    } else if (arg == "-oJ" && i + 1 < argc) {
+      cfg.jsonFile = argv[++i];
+    } else if (arg == "-oC" && i + 1 < argc) {
+      cfg.csvFile = argv[++i];
+    } else if (arg == "-oB" && i + 1 < argc) {
+      cfg.binaryFile = argv[++i];
     } else if (arg == "-v") {
       cfg.verboseMode = true;
     } else if (arg == "-nb") {
       cfg.grabBanner = false;
+    } else if (arg == "--engine" && i + 1 < argc) {
+      cfg.engine = argv[++i];
+      engineGiven = true;
+    } else if (arg == "-sS") {
+      cfg.engine = "syn";
+      engineGiven = true;
+    } else if (arg == "--sim" && i + 1 < argc) {
+      cfg.simProfile = argv[++i];
+      if (!engineGiven)
+        cfg.engine = "sim";
+    } else if (arg == "--inflight" && i + 1 < argc) {
+      cfg.inFlight = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--banner-conc" && i + 1 < argc) {
+      cfg.bannerConcurrency = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--reactors" && i + 1 < argc) {
+      cfg.reactors = std::max(0, std::stoi(argv[++i]));
+    } else if (arg == "--min-rate" && i + 1 < argc) {
+      cfg.minRate = std::max(0.0, std::stod(argv[++i]));
+    } else if (arg == "--max-rate" && i + 1 < argc) {
+      cfg.maxRate = std::max(0.0, std::stod(argv[++i]));
+    } else if (arg == "--no-adaptive") {
+      cfg.adaptive = false;
+    } else if (arg == "--services" && i + 1 < argc) {
+      cfg.servicesFile = argv[++i];
+    } else if (arg == "--fingerprints" && i + 1 < argc) {
+      cfg.fingerprintsFile = argv[++i];
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      cfg.checkpointFile = argv[++i];
+    } else if (arg == "--resume" && i + 1 < argc) {
+      cfg.resumeFile = argv[++i];
+    } else if (arg == "--metrics" && i + 1 < argc) {
+      cfg.metricsFile = argv[++i];
+    } else if (arg == "--build-service-db" && i + 2 < argc) {
+      std::string err;
+      if (!g_services.loadFile(argv[i + 1], err) ||
+          !g_services.saveBinary(argv[i + 2])) {
+        std::cerr << Color::RED << "  [!] Cannot build service database: "
+                  << (err.empty() ? argv[i + 2] : err) << "\n"
+                  << Color::RESET;
+        return 1;
+      }
+      std::cout << "  " << Color::BGREEN << "[✓]" << Color::RESET << " "
+                << g_services.nameCount() << " services written to "
+                << argv[i + 2] << "\n";
+      return 0;
+    } else if (arg == "--update-freq" && i + 2 < argc) {
+      std::vector<std::string> files(argv + i + 2, argv + argc);
+      std::string err;
+      uint64_t learned = updateFrequencies(argv[i + 1], files, err);
+      if (learned == 0) {
+        std::cerr << Color::RED << "  [!] Cannot update frequencies: " << err
+                  << "\n"
+                  << Color::RESET;
+        return 1;
+      }
+      std::cout << "  " << Color::BGREEN << "[✓]" << Color::RESET << " "
+                << argv[i + 1] << " updated from " << learned << " hosts in "
+                << files.size() << " result file(s); rebuild services.bin "
+                << "(make) to use it\n";
+      return 0;
+    } else if (arg == "--randomize") {
+      cfg.randomize = true;
+    } else if (arg == "--seed" && i + 1 < argc) {
+      cfg.seed = std::stoull(argv[++i]);
+      seeded = true;
+    } else if (arg == "--retries" && i + 1 < argc) {
+      cfg.retries = std::max(0, std::min(std::stoi(argv[++i]), 8));
     } else if (arg == "-h" || arg == "--help") {
       printHelp(argv[0]);
       return 0;
     }
   }
 
-  cfg.ports = parsePorts(portSpec);
+  if (cfg.engine != "thread") {
+#ifdef __linux__
+    bool known = cfg.engine == "epoll" || cfg.engine == "uring" ||
+                 cfg.engine == "syn" || cfg.engine == "sim";
+#else
+    bool known = cfg.engine == "sim";
+#endif
+    if (!known) {
+      std::cerr << Color::RED << "  [!] Unsupported engine on this platform: "
+                << cfg.engine << "\n"
+                << Color::RESET;
+      return 1;
+    }
+  }
+  if (cfg.engine == "syn")
+    cfg.grabBanner = false; // the handshake is never completed
+  if (!cfg.simProfile.empty() && cfg.engine != "sim" &&
+      cfg.engine != "thread") {
+    std::cerr << Color::RED << "  [!] --sim runs under --engine sim or "
+              << "thread, not " << cfg.engine << "\n"
+              << Color::RESET;
+    return 1;
+  }
+
+  if (cfg.target.empty() && cfg.targetFile.empty()) {
+    printHelp(argv[0]);
+    return 1;
+  }
+
+  cfg.ports = parsePorts(portSpec).toVector();
+  if (!pingSpec.empty())
+    cfg.pingPorts = parsePorts(pingSpec).toVector();
+  if (cfg.randomize && !seeded)
+    cfg.seed = ((uint64_t)std::random_device{}() << 32) ^ std::random_device{}();
   if (cfg.ports.empty()) {
     std::cerr << Color::RED << "  [!] No valid ports specified.\n"
               << Color::RESET;
     return 1;
   }
 
-  // ── Init Winsock ──
-  WSADATA wsaData;
-  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+  // ── Simulated Network ──
+  std::string simErr;
+  if (cfg.engine == "sim" || !cfg.simProfile.empty()) {
+    if (!g_simNet.configure(cfg.simProfile, simErr)) {
+      std::cerr << Color::RED << "  [!] Bad --sim profile item: " << simErr
+                << "\n"
+                << Color::RESET;
+      return 1;
+    }
+    g_sockets.setTransport(&g_simNet); // thread engine connects go there
+  }
+
+  // ── Load Service Names ──
+  std::string servicesErr;
+  std::string servicesFrom =
+      loadServices(cfg.servicesFile, argv[0], servicesErr);
+  if (servicesFrom.empty()) {
+    std::cerr << Color::RED << "  [!] Cannot load service database: "
+              << servicesErr << "\n"
+              << Color::RESET;
+    return 1;
+  }
+
+  prioritizePorts(cfg, portsGiven);
+
+  // ── Load Fingerprint Rules ──
+  std::string fingerprintsErr, fingerprintsFrom;
+  if (cfg.grabBanner) {
+    fingerprintsFrom =
+        loadFingerprints(cfg.fingerprintsFile, argv[0], fingerprintsErr);
+    if (!fingerprintsErr.empty()) {
+      std::cerr << Color::RED << "  [!] Cannot load fingerprints: "
+                << fingerprintsErr << "\n"
+                << Color::RESET;
+      return 1;
+    }
+  }
+
+  // ── Init Sockets (Winsock on Windows) ──
+  if (!net::startup()) {
     std::cerr << Color::RED << "  [!] WSAStartup failed.\n" << Color::RESET;
     return 1;
   }
 
-  // ── Resolve Target ──
+  // ── Probe Sockets: fd limit, source binding ──
+  SocketManager::raiseFdLimit();
+  std::string socketsErr;
+  if (!g_sockets.configure(cfg.sockets, socketsErr)) {
+    std::cerr << Color::RED << "  [!] " << socketsErr << "\n" << Color::RESET;
+    net::cleanup();
+    return 1;
+  }
+
+  // ── Resolve Targets ──
+  // A dry pass collects the hostnames, which are then resolved all at
+  // once; the real pass reads the answers back in spec order.
+  std::vector<std::string> hostNames;
+  {
+    TargetSet scratch;
+    std::string ignored;
+    auto collect = [&](const std::string &name) {
+      hostNames.push_back(name);
+      return std::vector<std::string>{"0.0.0.0"};
+    };
+    if (!cfg.target.empty())
+      scratch.addSpec(cfg.target, collect, ignored);
+    if (!cfg.targetFile.empty())
+      scratch.addFile(cfg.targetFile, collect, ignored);
+  }
+
+  AsyncResolver resolver(cfg.dns);
+  long long resolveMs = 0;
+  if (!hostNames.empty()) {
+    std::string dnsErr;
+    if (!cfg.dnsCacheFile.empty() &&
+        !resolver.loadCache(cfg.dnsCacheFile, dnsErr))
+      std::cerr << Color::YELLOW << "  [!] Ignoring DNS cache: " << dnsErr
+                << "\n"
+                << Color::RESET;
+    auto resolveStart = std::chrono::steady_clock::now();
+    resolver.resolve(hostNames);
+    resolveMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - resolveStart)
+                    .count();
+    if (!cfg.dnsCacheFile.empty() &&
+        !resolver.saveCache(cfg.dnsCacheFile, dnsErr))
+      std::cerr << Color::YELLOW << "  [!] Cannot save DNS cache: " << dnsErr
+                << "\n"
+                << Color::RESET;
+  }
+  auto lookup = [&](const std::string &name) { return resolver.find(name); };
+
+  std::string badTarget;
+  bool targetsOk = true;
+  if (!cfg.target.empty())
+    targetsOk = cfg.targets.addSpec(cfg.target, lookup, badTarget);
+  if (targetsOk && !cfg.targetFile.empty()) {
+    targetsOk = cfg.targets.addFile(cfg.targetFile, lookup, badTarget);
+    cfg.target += (cfg.target.empty() ? "@" : " + @") + cfg.targetFile;
+  }
+
   std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
             << " Resolving target: " << Color::BWHITE << cfg.target
             << Color::RESET << " ... ";
-  cfg.resolvedIP = resolveHost(cfg.target);
 
-  if (cfg.resolvedIP.empty()) {
+  if (!targetsOk || cfg.targets.empty()) {
     std::cout << Color::RED << "FAILED\n" << Color::RESET;
-    std::cerr << "  [!] Cannot resolve hostname: " << cfg.target << "\n";
-    WSACleanup();
+    std::cerr << "  [!] Cannot resolve target: "
+              << (badTarget.empty() ? cfg.target : badTarget) << "\n";
+    net::cleanup();
     return 1;
   }
-  std::cout << Color::BGREEN << cfg.resolvedIP << Color::RESET << "\n";
+  cfg.resolvedIP = cfg.targets.hostString(0);
+  if (cfg.targets.hostCount() == 1)
+    std::cout << Color::BGREEN << cfg.resolvedIP << Color::RESET << "\n";
+  else
+    std::cout << Color::BGREEN << cfg.targets.hostCount() << " hosts"
+              << Color::RESET << "\n";
+  if (!hostNames.empty()) {
+    const AsyncResolver::Stats &rs = resolver.stats();
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Resolved " << rs.names << " names in " << resolveMs
+              << " ms (" << rs.hosts << " hosts file, " << rs.cached
+              << " cached, " << rs.dns << " DNS, " << rs.system
+              << " system)\n";
+  }
+
+  // ── Merge Shard Checkpoints ──
+  if (!cfg.mergeFiles.empty()) {
+    int status = mergeShards(cfg);
+    net::cleanup();
+    return status;
+  }
+
+  // ── Checkpoint / Resume ──
+  std::unique_ptr<Checkpoint> checkpoint;
+  std::string checkpointPath =
+      cfg.checkpointFile.empty() ? cfg.resumeFile : cfg.checkpointFile;
+  if (!checkpointPath.empty()) {
+    checkpoint.reset(new Checkpoint(checkpointPath, cfg.targets.hostCount(),
+                                    cfg.ports, checkpointHash(cfg),
+                                    checkpointHash(cfg, true)));
+    std::string err;
+    if (!cfg.resumeFile.empty() && !checkpoint->load(cfg.resumeFile, err)) {
+      std::cerr << Color::RED << "  [!] Cannot resume: " << err << "\n"
+                << Color::RESET;
+      net::cleanup();
+      return 1;
+    }
+    if (!cfg.resumeFile.empty() && !(checkpoint->shard() == cfg.shard)) {
+      std::cerr << Color::RED << "  [!] Cannot resume: " << cfg.resumeFile
+                << " was written for shard " << checkpoint->shard().index + 1
+                << "/" << checkpoint->shard().count << "\n"
+                << Color::RESET;
+      net::cleanup();
+      return 1;
+    }
+    // Keep the interrupted run's order so the rest of it stays shuffled
+    if (!cfg.resumeFile.empty() && cfg.randomize)
+      cfg.seed = checkpoint->seed();
+    checkpoint->setSeed(cfg.seed);
+    checkpoint->setShard(cfg.shard);
+    g_checkpoint = checkpoint.get();
+  }
 
   // ── Print Scan Info ──
   // Get current time
@@ -725,7 +2198,7 @@ int main(int argc, char *argv[]) {
   auto nowT = std::chrono::system_clock::to_time_t(now);
   char timeBuf[64];
   struct tm tmInfo;
-  localtime_s(&tmInfo, &nowT);
+  net::localTime(nowT, tmInfo);
   strftime(timeBuf, sizeof(timeBuf), "%Y-%m-%d %H:%M:%S", &tmInfo);
 
   std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
@@ -733,37 +2206,143 @@ int main(int argc, char *argv[]) {
             << "\n";
   std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
             << " Ports to scan    : " << Color::WHITE << cfg.ports.size()
-            << Color::RESET << " (" << portSpec << ")\n";
+            << Color::RESET << " ("
+            << (cfg.topPorts > 0
+                    ? "top " + std::to_string(cfg.topPorts) +
+                          (portsGiven ? " of " + portSpec : std::string())
+                    : portSpec)
+            << ")\n";
+  std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+            << " Engine           : " << Color::WHITE << cfg.engine
+            << Color::RESET << "\n";
+  std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+            << " Service names    : " << Color::WHITE
+            << g_services.nameCount() << " (" << servicesFrom << ")"
+            << Color::RESET << "\n";
+  if (!fingerprintsFrom.empty())
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Fingerprints     : " << Color::WHITE
+              << g_fingerprints.size() << " rules (" << fingerprintsFrom
+              << ")" << Color::RESET << "\n";
+  if (cfg.randomize)
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Order            : " << Color::WHITE << "random (seed "
+              << cfg.seed << ")" << Color::RESET << "\n";
+  else if (cfg.freqOrder)
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Order            : " << Color::WHITE
+              << "likeliest open ports first" << Color::RESET << "\n";
+  if (!cfg.shard.all())
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Shard            : " << Color::WHITE
+              << cfg.shard.index + 1 << "/" << cfg.shard.count << " ("
+              << ProbeGenerator(cfg.targets, cfg.ports, nullptr, nullptr,
+                                nullptr, cfg.shard)
+                     .total()
+              << " of " << cfg.targets.hostCount() * cfg.ports.size()
+              << " probes)" << Color::RESET << "\n";
   std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
             << " Threads          : " << Color::WHITE << cfg.threads
             << Color::RESET << "\n";
   std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
             << " Timeout          : " << Color::WHITE << cfg.timeout << " ms"
             << Color::RESET << "\n";
+  std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+            << " Sockets          : " << Color::WHITE << "budget "
+            << g_sockets.budget() << ", RST close";
+  if (!cfg.sockets.sourceAddrs.empty()) {
+    std::cout << ", from ";
+    for (size_t i = 0; i < cfg.sockets.sourceAddrs.size(); i++)
+      std::cout << (i ? "," : "") << cfg.sockets.sourceAddrs[i];
+  }
+  if (cfg.sockets.portLo > 0)
+    std::cout << ", ports " << cfg.sockets.portLo << "-" << cfg.sockets.portHi;
+  if (cfg.sockets.synRetries > 0)
+    std::cout << ", " << cfg.sockets.synRetries << " SYN retries";
+  std::cout << Color::RESET << "\n";
   std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
             << " Banner grabbing  : " << Color::WHITE
             << (cfg.grabBanner ? "enabled" : "disabled") << Color::RESET
             << "\n";
+  if (cfg.minRate > 0 || cfg.maxRate > 0)
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Rate limits      : " << Color::WHITE
+              << (cfg.minRate > 0 ? std::to_string((long long)cfg.minRate)
+                                  : std::string("-"))
+              << " .. "
+              << (cfg.maxRate > 0 ? std::to_string((long long)cfg.maxRate)
+                                  : std::string("-"))
+              << " probes/s" << Color::RESET << "\n";
+  for (const auto &out : {std::make_pair("JSON Lines", &cfg.jsonFile),
+                          std::make_pair("CSV", &cfg.csvFile),
+                          std::make_pair("binary", &cfg.binaryFile)})
+    if (!out.second->empty())
+      std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+                << " Streaming        : " << Color::WHITE << *out.second
+                << " (" << out.first << ")" << Color::RESET << "\n";
+  if (!cfg.metricsFile.empty())
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Metrics          : " << Color::WHITE << cfg.metricsFile
+              << " (every " << Reporter::kMetricsMs / 1000 << "s)"
+              << Color::RESET << "\n";
+
+  if (checkpoint) {
+    std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+              << " Checkpoint       : " << Color::WHITE << checkpointPath
+              << " (every " << Reporter::kCheckpointMs / 1000 << "s)"
+              << Color::RESET << "\n";
+    if (!cfg.resumeFile.empty())
+      std::cout << "  " << Color::CYAN << "[*]" << Color::RESET
+                << " Resuming         : " << Color::WHITE
+                << checkpoint->done().count() << "/"
+                << checkpoint->done().size() << " probes done, "
+                << checkpoint->open().count(ResultStore::kOpen) << " open"
+                << Color::RESET << "\n";
+  }
+
+  // ── Open Output Streams ──
+  std::string streamErr;
+  if (!openStreams(cfg, streamErr)) {
+    std::cerr << Color::RED << "  [!] Cannot open output file: " << streamErr
+              << "\n"
+              << Color::RESET;
+    closeStreams();
+    net::cleanup();
+    return 1;
+  }
+  g_metricsFile = cfg.metricsFile;
+  if (!g_metricsFile.empty() && !writeMetrics(g_metricsFile)) {
+    std::cerr << Color::RED << "  [!] Cannot write metrics file: "
+              << g_metricsFile << "\n"
+              << Color::RESET;
+    closeStreams();
+    net::cleanup();
+    return 1;
+  }
+  g_keepResults = !cfg.outputFile.empty();
 
   // ── Start Scan ──
   auto scanStart = std::chrono::steady_clock::now();
-  {
-    runScan(cfg);
-    // ThreadPool destructor is called here, joining all threads
-  }
+  long long cpuStart = net::processCpuMs();
+  runScan(cfg); // every pass has joined its workers / reactors on return
   auto scanEnd = std::chrono::steady_clock::now();
   long long elapsedMs =
       std::chrono::duration_cast<std::chrono::milliseconds>(scanEnd - scanStart)
           .count();
 
+  long long cpuMs = net::processCpuMs() - cpuStart;
+  closeStreams();
+  g_checkpoint = nullptr;
+
   // ── Print Summary ──
-  printSummary(cfg, elapsedMs);
+  printSummary(cfg, elapsedMs, cpuMs);
 
   // ── Save Output File ──
   if (!cfg.outputFile.empty()) {
     saveResults(cfg, g_results, std::string(timeBuf));
   }
 
-  WSACleanup();
+  net::cleanup();
   return 0;
 }
+#endif // PORT_SCANNER_NO_MAIN
@@ -0,0 +1,125 @@
+/*
+ * result_store.h - Compact store for the results kept until the end
+ *
+ * Only open (and, when asked for, filtered) ports are kept, one 24-byte
+ * record each: host index, port, state, latency, service ID and two
+ * offsets into a shared string arena. Banners and version strings are
+ * interned: a service that answers the same banner on 10,000 hosts costs
+ * one copy plus 4 bytes per record, instead of a std::string apiece.
+ *
+ * Single-threaded: the reporter thread owns the store during a scan.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ResultStore {
+public:
+  enum State : uint8_t { kOpen = 0, kClosed = 1, kFiltered = 2 };
+
+  // What forEach() hands out; strings point into the arena
+  struct View {
+    uint64_t hostIdx;
+    int port;
+    State state;
+    uint32_t latencyMs;
+    uint16_t serviceId;
+    const char *banner;  // "" when none
+    const char *product; // "" when none
+  };
+
+  ResultStore() { clear(); }
+
+  void clear() {
+    records_.clear();
+    arena_.assign(1, '\0'); // offset 0 is the empty string
+    intern_.clear();
+    counts_[0] = counts_[1] = counts_[2] = 0;
+  }
+
+  void add(uint64_t hostIdx, int port, State state, long latencyMs,
+           uint16_t serviceId, const std::string &banner,
+           const std::string &product) {
+    Record r;
+    r.hostLo = (uint32_t)hostIdx;
+    r.latencyMs = latencyMs < 0 ? 0 : (uint32_t)latencyMs;
+    r.banner = intern(banner);
+    r.product = intern(product);
+    r.port = (uint16_t)port;
+    r.serviceId = serviceId;
+    r.state = state;
+    r.hostHi = (uint8_t)(hostIdx >> 32);
+    r.reserved = 0;
+    records_.push_back(r);
+    counts_[state]++;
+  }
+
+  size_t size() const { return records_.size(); }
+  size_t count(State s) const { return counts_[s]; }
+
+  // Bytes held by records, arena and intern table
+  size_t memoryBytes() const {
+    return records_.capacity() * sizeof(Record) + arena_.capacity() +
+           intern_.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 16);
+  }
+
+  // Calls f(const View &) in insertion order
+  template <class F> void forEach(F &&f) const {
+    for (const Record &r : records_) {
+      View v;
+      v.hostIdx = ((uint64_t)r.hostHi << 32) | r.hostLo;
+      v.port = r.port;
+      v.state = (State)r.state;
+      v.latencyMs = r.latencyMs;
+      v.serviceId = r.serviceId;
+      v.banner = arena_.data() + r.banner;
+      v.product = arena_.data() + r.product;
+      f(v);
+    }
+  }
+
+private:
+  struct Record {
+    uint32_t hostLo;
+    uint32_t latencyMs;
+    uint32_t banner;  // arena offset
+    uint32_t product; // arena offset
+    uint16_t port;
+    uint16_t serviceId;
+    uint8_t state;
+    uint8_t hostHi; // host index bits 32..39
+    uint16_t reserved;
+  };
+  static_assert(sizeof(Record) == 24, "Record should stay packed");
+
+  // Offset of s in the arena, appending it the first time it is seen.
+  // Keyed by hash; on the (rare) collision with a different string the
+  // new one is simply stored again.
+  uint32_t intern(const std::string &s) {
+    if (s.empty())
+      return 0;
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (unsigned char c : s)
+      h = (h ^ c) * 1099511628211ull;
+
+    auto it = intern_.find(h);
+    if (it != intern_.end() &&
+        std::strcmp(arena_.data() + it->second, s.c_str()) == 0)
+      return it->second;
+
+    uint32_t off = (uint32_t)arena_.size();
+    arena_.append(s.c_str(), s.size() + 1);
+    if (it == intern_.end())
+      intern_.emplace(h, off);
+    return off;
+  }
+
+  std::vector<Record> records_;
+  std::string arena_; // NUL-terminated strings
+  std::unordered_map<uint64_t, uint32_t> intern_;
+  size_t counts_[3];
+};
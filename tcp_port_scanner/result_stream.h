@@ -0,0 +1,629 @@
+/*
+ * result_stream.h - Incremental result output (JSON Lines, CSV, binary)
+ *
+ * Each ResultStream turns records into bytes for one output file and
+ * hands them to its own BufferedWriter. The writer thread does the file
+ * I/O: it swaps out the pending buffer and writes it when it grows past
+ * kFlushBytes or every kFlushMs, then flushes, so a consumer tailing the
+ * file sees results a fraction of a second after they are found and the
+ * scan never waits on the disk. ResultReader parses any of the three
+ * formats back (--update-freq learns port frequencies from them; --merge
+ * works on checkpoints, not on these files).
+ *
+ * Binary format (all integers little-endian):
+ *
+ *   file    "PSRES001"
+ *   record  u16 size          bytes that follow in this record
+ *           u8  state         0 open, 1 closed, 2 filtered
+ *           u8  addrLen       4 (IPv4) or 16 (IPv6)
+ *           u8  addr[addrLen] network byte order
+ *           u16 port
+ *           u32 rttMs         0xFFFFFFFF when unknown
+ *           u64 timeMs        Unix time the record was written
+ *           3 x (u16 len, bytes)   service, product, banner
+ */
+#pragma once
+
+#include "transport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ─────────────────────────────────────────────
+//  Buffered Writer Thread
+// ─────────────────────────────────────────────
+class BufferedWriter {
+public:
+  static constexpr size_t kFlushBytes = 256 * 1024;
+  static constexpr int kFlushMs = 200;
+
+  ~BufferedWriter() { close(); }
+
+  bool open(const std::string &path) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_)
+      return false;
+    thread_ = std::thread([this] { loop(); });
+    return true;
+  }
+
+  // Any thread; copies into the pending buffer and returns
+  void write(const char *data, size_t len) {
+    bool wake;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      pending_.append(data, len);
+      wake = pending_.size() >= kFlushBytes;
+    }
+    if (wake)
+      cond_.notify_one();
+  }
+
+  void write(const std::string &s) { write(s.data(), s.size()); }
+
+  // Writes out everything buffered, then stops the thread
+  void close() {
+    if (!file_)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    if (thread_.joinable())
+      thread_.join();
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+private:
+  void loop() {
+    std::string batch;
+    while (true) {
+      bool stopping;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait_for(lock, std::chrono::milliseconds(kFlushMs), [this] {
+          return stop_ || pending_.size() >= kFlushBytes;
+        });
+        batch.swap(pending_);
+        stopping = stop_;
+      }
+      if (!batch.empty()) {
+        std::fwrite(batch.data(), 1, batch.size(), file_);
+        std::fflush(file_);
+        batch.clear();
+      }
+      if (stopping)
+        return;
+    }
+  }
+
+  std::FILE *file_ = nullptr;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  std::string pending_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+// ─────────────────────────────────────────────
+//  Result Streams
+// ─────────────────────────────────────────────
+struct StreamRecord {
+  std::string host;
+  int port;
+  int state;  // 0 open, 1 closed, 2 filtered
+  long rttMs; // -1 when unknown
+  const char *service;
+  std::string product;
+  std::string banner;
+};
+
+inline const char *streamStateName(int state) {
+  return state == 0 ? "open" : state == 1 ? "closed" : "filtered";
+}
+
+class ResultStream {
+public:
+  virtual ~ResultStream() {}
+
+  bool open(const std::string &path) {
+    if (!out_.open(path))
+      return false;
+    begin();
+    return true;
+  }
+
+  virtual void write(const StreamRecord &r) = 0;
+
+  void close() { out_.close(); }
+
+protected:
+  virtual void begin() {}
+
+  static uint64_t nowMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  BufferedWriter out_;
+};
+
+// One JSON object per line
+class JsonLinesStream : public ResultStream {
+public:
+  void write(const StreamRecord &r) override {
+    std::string line;
+    line.reserve(160 + r.banner.size());
+    line += "{\"host\":";
+    quote(line, r.host);
+    line += ",\"port\":" + std::to_string(r.port);
+    line += ",\"state\":\"";
+    line += streamStateName(r.state);
+    line += "\",\"service\":";
+    quote(line, r.service);
+    if (r.rttMs >= 0)
+      line += ",\"rtt_ms\":" + std::to_string(r.rttMs);
+    if (!r.product.empty()) {
+      line += ",\"version\":";
+      quote(line, r.product);
+    }
+    if (!r.banner.empty()) {
+      line += ",\"banner\":";
+      quote(line, r.banner);
+    }
+    line += ",\"time\":" + std::to_string(nowMs()) + "}\n";
+    out_.write(line);
+  }
+
+private:
+  // Banners are raw bytes: valid UTF-8 is copied, any other byte >= 0x80
+  // is written as the Latin-1 character \u00XX so the line stays valid
+  static void quote(std::string &out, const std::string &s) {
+    static const char *hex = "0123456789abcdef";
+    out += '"';
+    for (size_t i = 0; i < s.size();) {
+      unsigned char c = (unsigned char)s[i];
+      size_t n = c < 0x80 ? 1 : utf8Length(s, i);
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += (char)c;
+      } else if (c < 0x20 || n == 0) {
+        out += "\\u00";
+        out += hex[c >> 4];
+        out += hex[c & 15];
+      } else {
+        out.append(s, i, n);
+      }
+      i += n ? n : 1;
+    }
+    out += '"';
+  }
+
+  // Length of the well-formed UTF-8 sequence starting at s[i] (lead byte
+  // >= 0x80), 0 when it is not one: no overlong forms, no surrogates,
+  // nothing above U+10FFFF
+  static size_t utf8Length(const std::string &s, size_t i) {
+    unsigned char c = (unsigned char)s[i];
+    size_t n;
+    unsigned char lo = 0x80, hi = 0xBF; // range of the second byte
+    if (c >= 0xC2 && c <= 0xDF) {
+      n = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+      n = 3;
+      lo = c == 0xE0 ? 0xA0 : 0x80;
+      hi = c == 0xED ? 0x9F : 0xBF;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+      n = 4;
+      lo = c == 0xF0 ? 0x90 : 0x80;
+      hi = c == 0xF4 ? 0x8F : 0xBF;
+    } else {
+      return 0;
+    }
+    if (i + n > s.size())
+      return 0;
+    for (size_t k = 1; k < n; k++) {
+      unsigned char b = (unsigned char)s[i + k];
+      if (b < (k == 1 ? lo : 0x80) || b > (k == 1 ? hi : 0xBF))
+        return 0;
+    }
+    return n;
+  }
+};
+
+// RFC 4180 with a header row
+class CsvStream : public ResultStream {
+public:
+  void write(const StreamRecord &r) override {
+    std::string line;
+    line.reserve(120 + r.banner.size());
+    field(line, r.host);
+    line += ',' + std::to_string(r.port) + ',' + streamStateName(r.state) +
+            ',';
+    field(line, r.service);
+    line += ',' + (r.rttMs >= 0 ? std::to_string(r.rttMs) : std::string()) +
+            ',';
+    field(line, r.product);
+    line += ',';
+    field(line, r.banner);
+    line += ',' + std::to_string(nowMs()) + "\r\n";
+    out_.write(line);
+  }
+
+protected:
+  void begin() override {
+    out_.write("host,port,state,service,rtt_ms,version,banner,time\r\n");
+  }
+
+private:
+  static void field(std::string &out, const std::string &s) {
+    if (s.find_first_of(",\"\r\n") == std::string::npos) {
+      out += s;
+      return;
+    }
+    out += '"';
+    for (char c : s) {
+      if (c == '"')
+        out += '"';
+      out += c;
+    }
+    out += '"';
+  }
+};
+
+// Length-prefixed records, see the format at the top of this file
+class BinaryStream : public ResultStream {
+public:
+  void write(const StreamRecord &r) override {
+    unsigned char addr[16];
+    uint8_t addrLen = 0;
+    if (inet_pton(AF_INET, r.host.c_str(), addr) == 1)
+      addrLen = 4;
+    else if (inet_pton(AF_INET6, r.host.c_str(), addr) == 1)
+      addrLen = 16;
+
+    std::string rec;
+    rec.reserve(64 + r.banner.size());
+    put(rec, (uint8_t)r.state, 1);
+    put(rec, addrLen, 1);
+    rec.append((const char *)addr, addrLen);
+    put(rec, (uint64_t)r.port, 2);
+    put(rec, r.rttMs >= 0 ? (uint64_t)r.rttMs : 0xFFFFFFFFull, 4);
+    put(rec, nowMs(), 8);
+    str(rec, r.service);
+    str(rec, r.product);
+    str(rec, r.banner);
+
+    std::string size;
+    put(size, (uint64_t)rec.size(), 2);
+    out_.write(size + rec);
+  }
+
+protected:
+  void begin() override { out_.write("PSRES001", 8); }
+
+private:
+  static void put(std::string &out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+      out += (char)((v >> (8 * i)) & 0xFF);
+  }
+
+  static void str(std::string &out, const std::string &s) {
+    size_t n = std::min<size_t>(s.size(), 1024);
+    put(out, n, 2);
+    out.append(s.data(), n);
+  }
+};
+
+// ─────────────────────────────────────────────
+//  Reading Results Back
+// ─────────────────────────────────────────────
+// Parses a file written by one of the streams above, telling the format
+// from its first bytes, and calls f(const StreamRecord &) per record. An
+// unterminated last record (scan killed mid-write) is ignored; any other
+// malformed record stops the read with err set to file and location.
+class ResultReader {
+public:
+  template <class F>
+  static bool read(const std::string &path, F &&f, std::string &err) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+      err = "cannot open " + path;
+      return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    std::string where;
+    bool ok;
+    if (data.compare(0, 8, "PSRES001") == 0)
+      ok = binary(data, f, where);
+    else if (data.compare(0, 15, "host,port,state") == 0)
+      ok = csv(data, f, where);
+    else
+      ok = jsonLines(data, f, where);
+    if (!ok)
+      err = path + ": " + where;
+    return ok;
+  }
+
+  // Inverse of streamStateName(); -1 when unknown
+  static int stateFromName(const std::string &name) {
+    return name == "open" ? 0 : name == "closed" ? 1
+                            : name == "filtered" ? 2
+                                                 : -1;
+  }
+
+private:
+  // One record being rebuilt; service needs storage behind its pointer
+  struct Fields {
+    StreamRecord rec;
+    std::string service;
+
+    Fields() { reset(); }
+    void reset() {
+      rec.host.clear();
+      rec.port = 0;
+      rec.state = -1;
+      rec.rttMs = -1;
+      rec.product.clear();
+      rec.banner.clear();
+      service.clear();
+    }
+    bool valid() const {
+      return !rec.host.empty() && rec.port > 0 && rec.port <= 65535 &&
+             rec.state >= 0;
+    }
+    template <class F> void emit(F &f) {
+      rec.service = service.c_str();
+      f((const StreamRecord &)rec);
+    }
+  };
+
+  template <class F>
+  static bool jsonLines(const std::string &data, F &f, std::string &where) {
+    Fields fl;
+    size_t pos = 0, lineNo = 0;
+    while (pos < data.size()) {
+      size_t eol = data.find('\n', pos);
+      if (eol == std::string::npos)
+        return true; // cut off mid-write
+      lineNo++;
+      size_t i = pos;
+      pos = eol + 1;
+      if (data.find_first_not_of(" \t\r", i) >= eol)
+        continue;
+      fl.reset();
+      if (!jsonObject(data, i, eol, fl) || !fl.valid()) {
+        where = "line " + std::to_string(lineNo) + ": bad record";
+        return false;
+      }
+      fl.emit(f);
+    }
+    return true;
+  }
+
+  // The flat objects JsonLinesStream writes: string and integer values
+  static bool jsonObject(const std::string &d, size_t i, size_t end,
+                         Fields &fl) {
+    auto skip = [&] {
+      while (i < end && (d[i] == ' ' || d[i] == '\t' || d[i] == '\r'))
+        i++;
+    };
+    skip();
+    if (i >= end || d[i++] != '{')
+      return false;
+    while (true) {
+      skip();
+      std::string key, str;
+      if (i >= end || !jsonString(d, i, end, key))
+        return false;
+      skip();
+      if (i >= end || d[i++] != ':')
+        return false;
+      skip();
+      long long num = 0;
+      if (i < end && d[i] == '"') {
+        if (!jsonString(d, i, end, str))
+          return false;
+      } else {
+        char *stop;
+        num = std::strtoll(d.c_str() + i, &stop, 10);
+        if (stop == d.c_str() + i)
+          return false;
+        i = (size_t)(stop - d.c_str());
+      }
+      if (key == "host")
+        fl.rec.host = str;
+      else if (key == "port")
+        fl.rec.port = (int)num;
+      else if (key == "state")
+        fl.rec.state = stateFromName(str);
+      else if (key == "service")
+        fl.service = str;
+      else if (key == "rtt_ms")
+        fl.rec.rttMs = (long)num;
+      else if (key == "version")
+        fl.rec.product = str;
+      else if (key == "banner")
+        fl.rec.banner = str;
+      skip();
+      if (i < end && d[i] == ',') {
+        i++;
+        continue;
+      }
+      return i < end && d[i] == '}';
+    }
+  }
+
+  static bool jsonString(const std::string &d, size_t &i, size_t end,
+                         std::string &out) {
+    if (d[i++] != '"')
+      return false;
+    while (i < end) {
+      char c = d[i++];
+      if (c == '"')
+        return true;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (i >= end)
+        return false;
+      c = d[i++];
+      if (c != 'u') {
+        out += c == 'n' ? '\n' : c == 'r' ? '\r' : c == 't' ? '\t' : c;
+        continue;
+      }
+      if (i + 4 > end)
+        return false;
+      unsigned long cp = std::strtoul(d.substr(i, 4).c_str(), nullptr, 16);
+      i += 4;
+      if (cp < 0x100) { // the writer escapes single control bytes
+        out += (char)cp;
+      } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+      } else {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+      }
+    }
+    return false;
+  }
+
+  // RFC 4180: quoted fields may hold commas, quotes and line breaks
+  template <class F>
+  static bool csv(const std::string &data, F &f, std::string &where) {
+    std::vector<std::string> header, row;
+    Fields fl;
+    size_t i = 0, rowNo = 0;
+    while (i < data.size()) {
+      row.clear();
+      if (!csvRow(data, i, row))
+        return true; // cut off mid-write
+      if (++rowNo == 1) {
+        header = row;
+        continue;
+      }
+      if (row.size() == 1 && row[0].empty())
+        continue;
+      fl.reset();
+      for (size_t c = 0; c < row.size() && c < header.size(); c++) {
+        const std::string &name = header[c], &v = row[c];
+        if (name == "host")
+          fl.rec.host = v;
+        else if (name == "port")
+          fl.rec.port = std::atoi(v.c_str());
+        else if (name == "state")
+          fl.rec.state = stateFromName(v);
+        else if (name == "service")
+          fl.service = v;
+        else if (name == "rtt_ms")
+          fl.rec.rttMs = v.empty() ? -1 : std::atol(v.c_str());
+        else if (name == "version")
+          fl.rec.product = v;
+        else if (name == "banner")
+          fl.rec.banner = v;
+      }
+      if (!fl.valid()) {
+        where = "row " + std::to_string(rowNo) + ": bad record";
+        return false;
+      }
+      fl.emit(f);
+    }
+    return true;
+  }
+
+  // One row from i; false when the data ends before its line break
+  static bool csvRow(const std::string &d, size_t &i,
+                     std::vector<std::string> &row) {
+    std::string field;
+    bool quoted = false;
+    while (i < d.size()) {
+      char c = d[i++];
+      if (quoted) {
+        if (c != '"')
+          field += c;
+        else if (i < d.size() && d[i] == '"')
+          field += d[i++];
+        else
+          quoted = false;
+      } else if (c == '"') {
+        quoted = true;
+      } else if (c == ',') {
+        row.push_back(field);
+        field.clear();
+      } else if (c == '\n') {
+        row.push_back(field);
+        return true;
+      } else if (c != '\r') {
+        field += c;
+      }
+    }
+    return false;
+  }
+
+  template <class F>
+  static bool binary(const std::string &data, F &f, std::string &where) {
+    const unsigned char *d = (const unsigned char *)data.data();
+    auto get = [d](size_t at, int bytes) {
+      uint64_t v = 0;
+      for (int b = 0; b < bytes; b++)
+        v |= (uint64_t)d[at + b] << (8 * b);
+      return v;
+    };
+    Fields fl;
+    size_t pos = 8, recNo = 0;
+    while (pos + 2 <= data.size()) {
+      size_t i = pos + 2, end = i + (size_t)get(pos, 2);
+      if (end > data.size())
+        return true; // cut off mid-write
+      pos = end;
+      recNo++;
+      fl.reset();
+      size_t addrLen = i + 2 <= end ? d[i + 1] : 0;
+      bool ok = (addrLen == 4 || addrLen == 16) && i + 16 + addrLen <= end;
+      if (ok) {
+        char text[INET6_ADDRSTRLEN];
+        fl.rec.state = d[i] <= 2 ? d[i] : -1;
+        if (inet_ntop(addrLen == 4 ? AF_INET : AF_INET6, d + i + 2, text,
+                      sizeof(text)))
+          fl.rec.host = text;
+        i += 2 + addrLen;
+        fl.rec.port = (int)get(i, 2);
+        uint64_t rtt = get(i + 2, 4);
+        fl.rec.rttMs = rtt == 0xFFFFFFFFull ? -1 : (long)rtt;
+        i += 14; // port, rtt, time
+        for (std::string *s : {&fl.service, &fl.rec.product, &fl.rec.banner}) {
+          size_t n = i + 2 <= end ? (size_t)get(i, 2) : end;
+          if (i + 2 + n > end) {
+            ok = false;
+            break;
+          }
+          s->assign(data, i + 2, n);
+          i += 2 + n;
+        }
+      }
+      if (!ok || !fl.valid()) {
+        where = "record " + std::to_string(recNo) + ": bad record";
+        return false;
+      }
+      fl.emit(f);
+    }
+    return true;
+  }
+};
@@ -0,0 +1,104 @@
+/*
+ * rtt.h - Per-host round-trip estimates and RTO-style connect timeouts
+ *
+ * Every answered connect (open or refused) is an RTT sample. Estimators
+ * follow RFC 6298: srtt/rttvar smoothing and RTO = srtt + 4 * rttvar,
+ * clamped to [kMinRtoMs, max timeout]. Hosts hash into a fixed table so
+ * memory does not grow with the target count; hosts sharing a bucket
+ * share an estimate. A host without samples yet borrows the global
+ * estimate, and with no samples at all the configured timeout is used.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class RttTable {
+public:
+  static constexpr int kMinRtoMs = 100;
+
+  explicit RttTable(int maxTimeoutMs, size_t buckets = 4096)
+      : maxTimeoutMs_(maxTimeoutMs), table_(buckets) {
+    for (auto &e : table_)
+      e.store(kEmpty, std::memory_order_relaxed);
+    global_.store(kEmpty, std::memory_order_relaxed);
+  }
+
+  void sample(uint64_t host, long rttMs) {
+    if (rttMs < 0)
+      return;
+    update(bucket(host), (float)rttMs);
+    update(global_, (float)rttMs);
+  }
+
+  // True once any host has answered
+  bool hasSamples() const {
+    return global_.load(std::memory_order_relaxed) != kEmpty;
+  }
+
+  // Connect timeout for a probe to `host`; backoff doubles it per retry
+  int timeoutFor(uint64_t host, int backoff = 1) const {
+    uint64_t word = bucketConst(host).load(std::memory_order_relaxed);
+    if (word == kEmpty)
+      word = global_.load(std::memory_order_relaxed);
+    if (word == kEmpty)
+      return maxTimeoutMs_;
+
+    float srtt, rttvar;
+    unpack(word, srtt, rttvar);
+    double rto = (srtt + std::max(1.0f, 4 * rttvar)) * backoff;
+    rto = std::max<double>(rto, kMinRtoMs * backoff);
+    return (int)std::min<double>(std::ceil(rto), maxTimeoutMs_);
+  }
+
+private:
+  // srtt and rttvar (ms, float) packed into one word so updates are a
+  // single CAS; a negative srtt marks "no sample yet"
+  static uint64_t pack(float srtt, float rttvar) {
+    uint32_t a, b;
+    std::memcpy(&a, &srtt, 4);
+    std::memcpy(&b, &rttvar, 4);
+    return ((uint64_t)b << 32) | a;
+  }
+  static void unpack(uint64_t w, float &srtt, float &rttvar) {
+    uint32_t a = (uint32_t)w, b = (uint32_t)(w >> 32);
+    std::memcpy(&srtt, &a, 4);
+    std::memcpy(&rttvar, &b, 4);
+  }
+  static constexpr uint64_t kEmpty = 0xBF800000u; // srtt -1.0f, rttvar 0
+
+  static size_t hashHost(uint64_t host, size_t n) {
+    return (size_t)((host * 0x9E3779B97F4A7C15ull) >> 32) % n;
+  }
+  std::atomic<uint64_t> &bucket(uint64_t host) {
+    return table_[hashHost(host, table_.size())];
+  }
+  const std::atomic<uint64_t> &bucketConst(uint64_t host) const {
+    return table_[hashHost(host, table_.size())];
+  }
+
+  static void update(std::atomic<uint64_t> &slot, float r) {
+    uint64_t old = slot.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+      float srtt, rttvar;
+      if (old == kEmpty) {
+        srtt = r;
+        rttvar = r / 2;
+      } else {
+        unpack(old, srtt, rttvar);
+        rttvar = 0.75f * rttvar + 0.25f * std::fabs(srtt - r);
+        srtt = 0.875f * srtt + 0.125f * r;
+      }
+      next = pack(srtt, rttvar);
+    } while (!slot.compare_exchange_weak(old, next, std::memory_order_relaxed));
+  }
+
+  int maxTimeoutMs_;
+  std::vector<std::atomic<uint64_t>> table_;
+  std::atomic<uint64_t> global_;
+};
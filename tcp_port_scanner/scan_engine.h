@@ -0,0 +1,78 @@
+/*
+ * scan_engine.h - Common types shared by the scan engines
+ *
+ * An engine pulls probes from a ProbeSource, runs the TCP connect and
+ * reports the outcome to a ProbeSink. Both callbacks may be invoked
+ * concurrently from several engine threads and must be thread-safe.
+ */
+#pragma once
+
+#include "transport.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// ─────────────────────────────────────────────
+//  Probe / Outcome
+// ─────────────────────────────────────────────
+struct Probe {
+  net::Endpoint ep;
+  int port = 0;
+  uint64_t id = 0;    // caller-defined work index
+  int timeoutMs = 0;  // connect timeout, 0 = EngineOptions::timeoutMs
+  uint64_t ticket = 0; // Throttle admission ticket
+};
+
+struct ProbeOutcome {
+  net::ConnectStatus status = net::ConnectStatus::Error;
+  long elapsedMs = -1;
+  long long elapsedUs = -1; // same, for the latency histograms
+  bool unreachable = false;  // Refused by an ICMP unreachable, not the host
+  std::string banner; // raw bytes, only from engines that read banners
+  // Connected socket of an open port when EngineOptions::keepOpen is set;
+  // ownership passes to the sink.
+  net::socket_t sock = net::kInvalidSocket;
+};
+
+// Port-specific request sent before reading a banner (nullptr = just read)
+inline const char *bannerProbe(int port) {
+  if (port == 80 || port == 8080 || port == 8000 || port == 8888)
+    return "HEAD / HTTP/1.0\r\nHost: localhost\r\n\r\n";
+  return nullptr;
+}
+
+// Returns false once there is no more work
+using ProbeSource = std::function<bool(Probe &)>;
+using ProbeSink = std::function<void(const Probe &, const ProbeOutcome &)>;
+
+// ─────────────────────────────────────────────
+//  Dispatch Throttle
+// ─────────────────────────────────────────────
+// Optional gate consulted before every connect. A successful tryAcquire()
+// hands out a ticket that must come back through exactly one release()
+// (connect finished) or cancel() (no probe was started after all).
+class Throttle {
+public:
+  virtual ~Throttle() {}
+  virtual bool tryAcquire(uint64_t &ticket) = 0;
+  virtual void cancel(uint64_t ticket) = 0;
+  virtual void release(uint64_t ticket, const ProbeOutcome &out) = 0;
+};
+
+class SocketManager; // socket_manager.h
+
+// ─────────────────────────────────────────────
+//  Engine Options
+// ─────────────────────────────────────────────
+struct EngineOptions {
+  int timeoutMs = 2000;
+  int reactors = 0;       // event-loop threads, 0 = one per core
+  int maxInFlight = 4096; // connects outstanding across all reactors
+  bool pinThreads = true; // pin reactor i to core i
+  bool grabBanner = false; // engine reads banners itself (io_uring)
+  bool keepOpen = false;   // hand open sockets to the sink (epoll)
+  Throttle *throttle = nullptr; // limits connects in flight / per second
+  SocketManager *sockets = nullptr; // opens / closes probe sockets
+  int bannerTimeoutMs = 1000;
+};
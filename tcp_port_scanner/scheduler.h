@@ -0,0 +1,116 @@
+/*
+ * scheduler.h - Work-stealing pool over contiguous index ranges
+ *
+ * Work is a plain index range [0, count). Each worker starts with an
+ * equal contiguous slice and takes `grain`-sized Chunks from its front;
+ * an idle worker steals the back half of a victim's remaining slice.
+ * Every worker has its own lock and cache line, so the only shared
+ * traffic is the occasional steal, and no task object is allocated per
+ * index. Nothing is ever added once a run starts, so a worker that finds
+ * every slice empty is done.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Chunk {
+  uint64_t begin;
+  uint64_t end; // exclusive
+};
+
+class WorkStealingPool {
+public:
+  // Called once per chunk; `worker` is the index of the calling thread
+  using Body = std::function<void(int worker, const Chunk &chunk)>;
+
+  explicit WorkStealingPool(int workers)
+      : slices_((size_t)std::max(1, workers)) {}
+
+  ~WorkStealingPool() { wait(); }
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  int workers() const { return (int)slices_.size(); }
+
+  // Start processing [0, count) in chunks of at most `grain` indices
+  void start(uint64_t count, uint64_t grain, Body body) {
+    wait();
+    grain_ = std::max<uint64_t>(1, grain);
+    body_ = std::move(body);
+
+    uint64_t n = slices_.size();
+    for (uint64_t i = 0; i < n; i++) {
+      slices_[i].lo = count * i / n;
+      slices_[i].hi = count * (i + 1) / n;
+    }
+    for (int i = 0; i < (int)n; i++)
+      threads_.emplace_back([this, i] { workerLoop(i); });
+  }
+
+  // Block until every chunk has been processed
+  void wait() {
+    for (auto &t : threads_)
+      t.join();
+    threads_.clear();
+  }
+
+private:
+  struct alignas(64) Slice {
+    std::mutex mtx;
+    uint64_t lo = 0, hi = 0;
+  };
+
+  void workerLoop(int self) {
+    Chunk c;
+    while (popLocal(self, c) || steal(self, c))
+      body_(self, c);
+  }
+
+  bool popLocal(int self, Chunk &c) {
+    Slice &s = slices_[(size_t)self];
+    std::lock_guard<std::mutex> lock(s.mtx);
+    if (s.lo >= s.hi)
+      return false;
+    c.begin = s.lo;
+    c.end = std::min(s.hi, s.lo + grain_);
+    s.lo = c.end;
+    return true;
+  }
+
+  bool steal(int self, Chunk &c) {
+    int n = (int)slices_.size();
+    for (int k = 1; k < n; k++) {
+      Slice &victim = slices_[(size_t)((self + k) % n)];
+      uint64_t lo, hi;
+      {
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        uint64_t left = victim.hi - std::min(victim.lo, victim.hi);
+        if (left == 0)
+          continue;
+        // Small remainders go whole; otherwise take the back half
+        lo = left <= grain_ ? victim.lo : victim.lo + left / 2;
+        hi = victim.hi;
+        victim.hi = lo;
+      }
+      Slice &mine = slices_[(size_t)self];
+      {
+        std::lock_guard<std::mutex> lock(mine.mtx);
+        mine.lo = lo;
+        mine.hi = hi;
+      }
+      return popLocal(self, c);
+    }
+    return false;
+  }
+
+  std::vector<Slice> slices_;
+  std::vector<std::thread> threads_;
+  uint64_t grain_ = 1;
+  Body body_;
+};
@@ -0,0 +1,326 @@
+/*
+ * service_db.h - Port -> service name table loaded from a data file
+ *
+ * The database is held as one flat binary image:
+ *
+ *   Header            magic "PSSVCDB1", name count, name blob size
+ *   uint16_t ids[65536]      service ID per port (0 = "unknown")
+ *   uint32_t freq[65536]     open frequency, parts per million
+ *   uint32_t offsets[count]  start of each name in the blob
+ *   char     blob[]          NUL-terminated, interned names
+ *
+ * A text file in nmap-services format ("name port/tcp frequency") is
+ * parsed into that image in memory; a compiled .bin file is mapped
+ * directly (mmap on POSIX), so startup does no parsing at all. Lookups
+ * are two array reads and results carry only the 16-bit ID.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class ServiceDb {
+public:
+  static constexpr uint16_t kUnknown = 0;
+
+  ServiceDb() = default;
+  ~ServiceDb() { unmap(); }
+  ServiceDb(const ServiceDb &) = delete;
+  ServiceDb &operator=(const ServiceDb &) = delete;
+
+  struct Entry {
+    int port;
+    const char *name;
+    double frequency;
+  };
+
+  // Replace the table with a fixed list (fallback when no file is found)
+  void loadEntries(const std::vector<Entry> &entries) {
+    Builder b;
+    for (const auto &e : entries)
+      b.add(e.port, e.name, e.frequency);
+    std::vector<char> image;
+    b.build(image);
+    adopt(image);
+  }
+
+  // Text (nmap-services format) or compiled binary, detected by magic
+  bool loadFile(const std::string &path, std::string &err) {
+    if (isBinary(path))
+      return mapBinary(path, err);
+
+    std::ifstream in(path);
+    if (!in.is_open()) {
+      err = "cannot open " + path;
+      return false;
+    }
+    Builder b;
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+      lineNo++;
+      size_t hash = line.find('#');
+      if (hash != std::string::npos)
+        line.erase(hash);
+      std::istringstream ls(line);
+      std::string name, portProto;
+      double freq = 0;
+      if (!(ls >> name >> portProto))
+        continue; // blank / comment
+      ls >> freq;
+      size_t slash = portProto.find('/');
+      if (slash == std::string::npos ||
+          portProto.compare(slash + 1, std::string::npos, "tcp") != 0)
+        continue; // udp/sctp entries are not used
+      std::string digits = portProto.substr(0, slash);
+      char *end = nullptr;
+      long port = std::strtol(digits.c_str(), &end, 10);
+      if (digits.empty() || *end != '\0' || port < 0 || port > 65535) {
+        err = path + ":" + std::to_string(lineNo) + ": bad port";
+        return false;
+      }
+      b.add((int)port, name, freq);
+    }
+    std::vector<char> image;
+    b.build(image);
+    adopt(image);
+    return true;
+  }
+
+  // Write the current image so later runs can map it
+  bool saveBinary(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open() || !image_)
+      return false;
+    out.write(image_, (std::streamsize)imageSize_);
+    return (bool)out;
+  }
+
+  uint16_t lookup(int port) const {
+    return (ids_ && port >= 0 && port <= 65535) ? ids_[port] : kUnknown;
+  }
+
+  const char *name(uint16_t id) const {
+    return (id == kUnknown || id > nameCount_) ? "unknown"
+                                               : blob_ + offsets_[id - 1];
+  }
+
+  const char *nameForPort(int port) const { return name(lookup(port)); }
+
+  // ID of a name (case-insensitive), kUnknown when absent. Linear; for
+  // the occasional reverse lookup, not per-probe work.
+  uint16_t find(const std::string &name) const {
+    for (uint32_t i = 0; i < nameCount_; i++) {
+      const char *n = blob_ + offsets_[i];
+      if (std::strlen(n) == name.size() &&
+          std::equal(name.begin(), name.end(), n, [](char a, char b) {
+            return std::tolower((unsigned char)a) ==
+                   std::tolower((unsigned char)b);
+          }))
+        return (uint16_t)(i + 1);
+    }
+    return kUnknown;
+  }
+
+  // Fraction of hosts with the port open (0 when unknown)
+  double frequency(int port) const {
+    return (freq_ && port >= 0 && port <= 65535) ? freq_[port] / 1e6 : 0.0;
+  }
+
+  size_t nameCount() const { return nameCount_; }
+
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t nameCount;
+    uint32_t blobSize;
+    uint32_t reserved;
+  };
+  static constexpr const char *kMagic = "PSSVCDB1";
+  static constexpr size_t kIdsOff = sizeof(Header);
+  static constexpr size_t kFreqOff = kIdsOff + 65536 * sizeof(uint16_t);
+  static constexpr size_t kOffsetsOff = kFreqOff + 65536 * sizeof(uint32_t);
+
+  // Collects (port, name, freq) triples and lays out the binary image
+  class Builder {
+  public:
+    Builder() : ids_(65536, kUnknown), freq_(65536, 0) {}
+
+    void add(int port, const std::string &name, double freq) {
+      auto it = intern_.find(name);
+      uint16_t id;
+      if (it != intern_.end()) {
+        id = it->second;
+      } else {
+        if (names_.size() >= 0xFFFE)
+          return; // ID space exhausted
+        names_.push_back(name);
+        id = (uint16_t)names_.size();
+        intern_[name] = id;
+      }
+      ids_[(size_t)port] = id;
+      freq_[(size_t)port] = (uint32_t)(std::max(0.0, std::min(freq, 1.0)) * 1e6);
+    }
+
+    void build(std::vector<char> &image) const {
+      std::vector<uint32_t> offsets;
+      std::string blob;
+      for (const auto &n : names_) {
+        offsets.push_back((uint32_t)blob.size());
+        blob += n;
+        blob += '\0';
+      }
+      Header h;
+      std::memcpy(h.magic, kMagic, 8);
+      h.version = 1;
+      h.nameCount = (uint32_t)names_.size();
+      h.blobSize = (uint32_t)blob.size();
+      h.reserved = 0;
+
+      image.assign(kOffsetsOff + offsets.size() * 4 + blob.size(), 0);
+      std::memcpy(image.data(), &h, sizeof(h));
+      std::memcpy(image.data() + kIdsOff, ids_.data(), 65536 * 2);
+      std::memcpy(image.data() + kFreqOff, freq_.data(), 65536 * 4);
+      if (!offsets.empty())
+        std::memcpy(image.data() + kOffsetsOff, offsets.data(),
+                    offsets.size() * 4);
+      std::memcpy(image.data() + kOffsetsOff + offsets.size() * 4, blob.data(),
+                  blob.size());
+    }
+
+  private:
+    std::vector<uint16_t> ids_;
+    std::vector<uint32_t> freq_;
+    std::vector<std::string> names_;
+    std::map<std::string, uint16_t> intern_;
+  };
+
+  static bool isBinary(const std::string &path) {
+    char magic[8] = {};
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+      return false;
+    size_t n = std::fread(magic, 1, 8, f);
+    std::fclose(f);
+    return n == 8 && std::memcmp(magic, kMagic, 8) == 0;
+  }
+
+  // The current table stays in place unless the new one is valid
+  bool mapBinary(const std::string &path, std::string &err) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0)
+        close(fd);
+      err = "cannot open " + path;
+      return false;
+    }
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      err = "cannot map " + path;
+      return false;
+    }
+    size_t size = (size_t)st.st_size;
+    if (!attach((const char *)p, size)) {
+      munmap(p, size);
+      err = path + ": corrupt service database";
+      return false;
+    }
+    unmap(); // the previous image
+    std::vector<char>().swap(owned_);
+    mapped_ = p;
+    mappedSize_ = size;
+    return true;
+#else
+    // No mmap here: read the image into memory instead
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> image((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+    if (!attach(image.data(), image.size())) {
+      err = path + ": corrupt service database";
+      return false;
+    }
+    owned_.swap(image);
+    return true;
+#endif
+  }
+
+  // Take over a freshly built image (always valid)
+  void adopt(std::vector<char> &image) {
+    attach(image.data(), image.size());
+    owned_.swap(image); // the buffer moves, image_ stays valid
+    unmap();
+  }
+
+  // Point the lookups at image once every offset in it checks out against
+  // size; on failure nothing changes
+  bool attach(const char *image, size_t size) {
+    if (size < kOffsetsOff)
+      return false;
+    Header h;
+    std::memcpy(&h, image, sizeof(h));
+    if (std::memcmp(h.magic, kMagic, 8) != 0 || h.version != 1 ||
+        h.nameCount > 0xFFFF ||
+        size < kOffsetsOff + (size_t)h.nameCount * 4 + h.blobSize)
+      return false;
+    // Every name must start inside the blob and end with a NUL in it
+    const char *blob = image + kOffsetsOff + (size_t)h.nameCount * 4;
+    if (h.nameCount > 0 && (h.blobSize == 0 || blob[h.blobSize - 1] != '\0'))
+      return false;
+    for (uint32_t i = 0; i < h.nameCount; i++) {
+      uint32_t off;
+      std::memcpy(&off, image + kOffsetsOff + (size_t)i * 4, 4);
+      if (off >= h.blobSize)
+        return false;
+    }
+    image_ = image;
+    imageSize_ = size;
+    nameCount_ = h.nameCount;
+    ids_ = (const uint16_t *)(image + kIdsOff);
+    freq_ = (const uint32_t *)(image + kFreqOff);
+    offsets_ = (const uint32_t *)(image + kOffsetsOff);
+    blob_ = image + kOffsetsOff + (size_t)h.nameCount * 4;
+    return true;
+  }
+
+  void unmap() {
+#ifndef _WIN32
+    if (mapped_)
+      munmap(mapped_, mappedSize_);
+#endif
+    mapped_ = nullptr;
+    mappedSize_ = 0;
+  }
+
+  std::vector<char> owned_; // image built from text / fallback entries
+  void *mapped_ = nullptr;  // image mapped from a .bin file
+  size_t mappedSize_ = 0;
+
+  const char *image_ = nullptr;
+  size_t imageSize_ = 0;
+  size_t nameCount_ = 0;
+  const uint16_t *ids_ = nullptr;
+  const uint32_t *freq_ = nullptr;
+  const uint32_t *offsets_ = nullptr;
+  const char *blob_ = nullptr;
+};
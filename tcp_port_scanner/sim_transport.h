@@ -0,0 +1,405 @@
+/*
+ * sim_transport.h - In-process simulated network and the "sim" engine
+ *
+ * SimNetwork answers probes from a profile instead of the wire: which
+ * ports are open, closed or filtered, how long a reply takes, how many
+ * SYNs are lost, which hosts are down and what each service sends as its
+ * banner. It is driven in two ways:
+ *
+ *   - as a SocketManager::Transport under connectTimed(), so the thread
+ *     engine (WorkStealingPool workers, blocking connects, the banner
+ *     stage) runs on it unchanged: --sim <profile> --engine thread
+ *   - by SimEngine, through the same ProbeSource / ProbeSink / Throttle
+ *     contract as the epoll and io_uring engines (--engine sim)
+ *
+ * Either way the scan pipeline (generator, congestion control, RTT
+ * estimation, retries, fingerprinting, reporting) is the production code.
+ * The epoll and io_uring engines themselves cannot run on it: their
+ * sockets are kernel objects completed by epoll_wait() / the ring, which
+ * only an emulated kernel could fake. SimEngine stands in for them with
+ * the same per-reactor in-flight window, so what they are measured on
+ * here is the pipeline around them, not their system calls.
+ *
+ * Profile: ';'-separated key=value items, or "@file" with one per line.
+ *
+ *   open=22,80,8000-8100     ports that accept
+ *   filtered=135-139         ports that never answer
+ *   default=closed           state of every other port (closed|filtered|open)
+ *   latency=normal:20:5      fixed:<ms> | uniform:<lo>:<hi> |
+ *                            normal:<mean>:<sd> | exp:<mean>
+ *   loss=0.01                chance that a probe gets no reply at all
+ *   down=0.1                 fraction of hosts that answer nothing
+ *   banner.22=SSH-2.0-...    banner sent on a port (\r \n \t \\ escapes)
+ *   seed=1                   varies down hosts, latency and loss draws
+ *
+ * Every draw is a hash of (seed, address, port, attempt), so a given
+ * probe always gets the same answer; only which attempt a retry is
+ * depends on timing.
+ */
+#pragma once
+
+#include "scan_engine.h"
+#include "socket_manager.h"
+#include "targets.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ─────────────────────────────────────────────
+//  Simulated Network
+// ─────────────────────────────────────────────
+class SimNetwork : public SocketManager::Transport {
+public:
+  enum class State { Open, Closed, Filtered };
+
+  SimNetwork() : attempts_(new std::atomic<uint8_t>[kAttemptSlots]) {
+    resetAttempts();
+  }
+
+  // Make the next probe of every index its first attempt again
+  void resetAttempts() {
+    for (size_t i = 0; i < kAttemptSlots; i++)
+      attempts_[i].store(0, std::memory_order_relaxed);
+  }
+
+  // Parse a profile (see the top of this file); err names the bad item
+  bool configure(const std::string &spec, std::string &err) {
+    std::string text = spec;
+    if (!text.empty() && text[0] == '@') {
+      std::ifstream in(text.substr(1));
+      if (!in.is_open()) {
+        err = "cannot open " + text.substr(1);
+        return false;
+      }
+      std::string line;
+      text.clear();
+      while (std::getline(in, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos)
+          line.erase(hash);
+        text += line + ";";
+      }
+    }
+
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ';')) {
+      item.erase(0, item.find_first_not_of(" \t\r"));
+      item.erase(item.find_last_not_of(" \t\r") + 1);
+      if (item.empty())
+        continue;
+      size_t eq = item.find('=');
+      if (eq == std::string::npos || !setItem(item.substr(0, eq),
+                                              item.substr(eq + 1))) {
+        err = item;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // What the host really has on the port (no loss applied)
+  State truth(const net::Endpoint &ep, int port) const {
+    if (down_ > 0 && unit(hash(addrKey(ep), 0, 0, 1)) < down_)
+      return State::Filtered;
+    if (open_.contains(port))
+      return State::Open;
+    if (filtered_.contains(port))
+      return State::Filtered;
+    return defaultState_;
+  }
+
+  // One probe: what the scanner sees and after how long (ms). Thread-safe.
+  net::ConnectStatus probe(const Probe &p, double &latencyMs,
+                           std::string &banner) {
+    uint64_t addr = addrKey(p.ep);
+    uint8_t attempt = attempts_[(size_t)(p.id % kAttemptSlots)].fetch_add(
+        1, std::memory_order_relaxed);
+    uint64_t h = hash(addr, p.port, attempt, 2);
+    latencyMs = drawLatency(h);
+
+    State s = truth(p.ep, p.port);
+    if (s == State::Filtered || (loss_ > 0 && unit(hash(h, 3, 0, 0)) < loss_))
+      return net::ConnectStatus::TimedOut;
+    if (s == State::Closed)
+      return net::ConnectStatus::Refused;
+    auto it = banners_.find(p.port);
+    if (it != banners_.end())
+      banner = it->second;
+    return net::ConnectStatus::Open;
+  }
+
+  // probe() as the scanner sees it within timeoutMs: a reply that would
+  // come too late is a timeout, and only an open port sends a banner
+  void answer(const Probe &p, int timeoutMs, ProbeOutcome &out) {
+    double latency = 0;
+    out.status = probe(p, latency, out.banner);
+    if (out.status != net::ConnectStatus::TimedOut && latency >= timeoutMs)
+      out.status = net::ConnectStatus::TimedOut;
+    if (out.status == net::ConnectStatus::TimedOut) {
+      latency = timeoutMs;
+      out.banner.clear();
+    }
+    out.elapsedMs = (long)latency;
+    out.elapsedUs = (long long)(latency * 1000);
+  }
+
+  // SocketManager::Transport: one blocking connect, for the thread engine
+  net::ConnectStatus connect(const net::Endpoint &ep, int timeoutMs,
+                             long &elapsedMs, std::string &banner) override {
+    Probe p;
+    p.ep = ep;
+    // sin_port and sin6_port share their offset
+    p.port = ntohs(((const sockaddr_in *)&ep.addr)->sin_port);
+    p.id = hash(addrKey(ep), (uint64_t)p.port, 0, 4); // attempt slot
+    ProbeOutcome out;
+    answer(p, timeoutMs, out);
+    std::this_thread::sleep_for(std::chrono::microseconds(out.elapsedUs));
+    elapsedMs = out.elapsedMs;
+    banner = std::move(out.banner);
+    return out.status;
+  }
+
+  const PortSet &openPorts() const { return open_; }
+
+private:
+  enum class Dist { Fixed, Uniform, Normal, Exp };
+  static constexpr size_t kAttemptSlots = 1 << 16;
+
+  bool setItem(const std::string &key, const std::string &value) {
+    try {
+      if (key == "open" || key == "filtered") {
+        PortSet &set = key == "open" ? open_ : filtered_;
+        std::stringstream ss(value);
+        std::string tok;
+        while (std::getline(ss, tok, ',')) {
+          size_t dash = tok.find('-');
+          if (dash == std::string::npos)
+            set.add(std::stoi(tok));
+          else
+            set.addRange(std::stoi(tok.substr(0, dash)),
+                         std::stoi(tok.substr(dash + 1)));
+        }
+      } else if (key == "default") {
+        if (value == "closed")
+          defaultState_ = State::Closed;
+        else if (value == "filtered")
+          defaultState_ = State::Filtered;
+        else if (value == "open")
+          defaultState_ = State::Open;
+        else
+          return false;
+      } else if (key == "latency") {
+        std::vector<std::string> f;
+        std::stringstream ss(value);
+        std::string tok;
+        while (std::getline(ss, tok, ':'))
+          f.push_back(tok);
+        if (f.size() < 2)
+          return false;
+        a_ = std::stod(f[1]);
+        b_ = f.size() > 2 ? std::stod(f[2]) : 0;
+        if (f[0] == "fixed")
+          dist_ = Dist::Fixed;
+        else if (f[0] == "uniform")
+          dist_ = Dist::Uniform;
+        else if (f[0] == "normal")
+          dist_ = Dist::Normal;
+        else if (f[0] == "exp")
+          dist_ = Dist::Exp;
+        else
+          return false;
+      } else if (key == "loss") {
+        loss_ = std::stod(value);
+      } else if (key == "down") {
+        down_ = std::stod(value);
+      } else if (key == "seed") {
+        seed_ = std::stoull(value);
+      } else if (key.compare(0, 7, "banner.") == 0) {
+        banners_[std::stoi(key.substr(7))] = unescape(value);
+      } else {
+        return false;
+      }
+    } catch (...) {
+      return false;
+    }
+    return true;
+  }
+
+  static std::string unescape(const std::string &s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+      if (s[i] != '\\' || i + 1 == s.size()) {
+        out += s[i];
+        continue;
+      }
+      char e = s[++i];
+      out += e == 'r' ? '\r' : e == 'n' ? '\n' : e == 't' ? '\t' : e;
+    }
+    return out;
+  }
+
+  static uint64_t addrKey(const net::Endpoint &ep) {
+    const unsigned char *b = (const unsigned char *)&ep.addr;
+    uint64_t h = 0;
+    if (ep.addr.ss_family == AF_INET) {
+      const sockaddr_in *v4 = (const sockaddr_in *)&ep.addr;
+      return ntohl(v4->sin_addr.s_addr);
+    }
+    for (size_t i = 0; i < (size_t)ep.len; i++)
+      h = h * 131 + b[i];
+    return h;
+  }
+
+  uint64_t hash(uint64_t a, uint64_t b, uint64_t c, uint64_t d) const {
+    uint64_t x = seed_ ^ (a * 0x9E3779B97F4A7C15ull) ^
+                 (b * 0xC2B2AE3D27D4EB4Full) ^ (c * 0x165667B19E3779F9ull) ^
+                 (d * 0xD6E8FEB86659FD93ull);
+    // splitmix64 finaliser
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  // Uniform in [0, 1)
+  static double unit(uint64_t h) { return (double)(h >> 11) * 0x1.0p-53; }
+
+  double drawLatency(uint64_t h) const {
+    double u = unit(h), v = unit(h * 0x9E3779B97F4A7C15ull + 1);
+    double ms = a_;
+    switch (dist_) {
+    case Dist::Fixed:
+      break;
+    case Dist::Uniform:
+      ms = a_ + (b_ - a_) * u;
+      break;
+    case Dist::Normal: // Box-Muller
+      ms = a_ + b_ * std::sqrt(-2.0 * std::log(std::max(u, 1e-12))) *
+                    std::cos(6.283185307179586 * v);
+      break;
+    case Dist::Exp:
+      ms = -a_ * std::log(std::max(1.0 - u, 1e-12));
+      break;
+    }
+    return std::max(0.0, ms);
+  }
+
+  PortSet open_, filtered_;
+  State defaultState_ = State::Closed;
+  Dist dist_ = Dist::Fixed;
+  double a_ = 1, b_ = 0; // distribution parameters
+  double loss_ = 0, down_ = 0;
+  uint64_t seed_ = 0;
+  std::map<int, std::string> banners_;
+  std::unique_ptr<std::atomic<uint8_t>[]> attempts_;
+};
+
+// ─────────────────────────────────────────────
+//  Simulated Engine
+// ─────────────────────────────────────────────
+// Like the epoll engine, each reactor keeps up to its share of
+// maxInFlight probes outstanding; here "outstanding" is an entry in a
+// deadline heap that completes when its simulated reply (or timeout) is
+// due. Banners are delivered with the outcome, as io_uring does.
+class SimEngine {
+public:
+  SimEngine(const EngineOptions &opts, SimNetwork &net)
+      : opts_(opts), net_(net) {}
+
+  void run(const ProbeSource &source, const ProbeSink &sink) {
+    int reactors = opts_.reactors > 0
+                       ? opts_.reactors
+                       : (int)std::max(1u, std::thread::hardware_concurrency());
+    int perReactor = std::max(1, opts_.maxInFlight / reactors);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < reactors; i++)
+      threads.emplace_back(
+          [this, perReactor, &source, &sink] { loop(perReactor, source, sink); });
+    for (auto &t : threads)
+      t.join();
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr int kTickMs = 5; // recheck a throttled window
+
+  struct Pending {
+    Clock::time_point due;
+    Probe probe;
+    ProbeOutcome out;
+    bool operator>(const Pending &o) const { return due > o.due; }
+  };
+
+  void loop(int capacity, const ProbeSource &source, const ProbeSink &sink) {
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>>
+        heap;
+    bool exhausted = false;
+
+    while (true) {
+      // ── Start probes up to capacity ──
+      bool throttled = false;
+      auto now = Clock::now();
+      while (!exhausted && (int)heap.size() < capacity) {
+        uint64_t ticket = 0;
+        if (opts_.throttle && !opts_.throttle->tryAcquire(ticket)) {
+          throttled = true;
+          break;
+        }
+        Pending pe;
+        if (!source(pe.probe)) {
+          if (opts_.throttle)
+            opts_.throttle->cancel(ticket);
+          exhausted = true;
+          break;
+        }
+        pe.probe.ticket = ticket;
+        int timeoutMs =
+            pe.probe.timeoutMs > 0 ? pe.probe.timeoutMs : opts_.timeoutMs;
+        net_.answer(pe.probe, timeoutMs, pe.out);
+        if (!opts_.grabBanner)
+          pe.out.banner.clear();
+        pe.due = now + std::chrono::microseconds(pe.out.elapsedUs);
+        heap.push(std::move(pe));
+      }
+      if (heap.empty()) {
+        if (exhausted)
+          return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(kTickMs));
+        continue;
+      }
+
+      // ── Complete everything that is due ──
+      now = Clock::now();
+      while (!heap.empty() && heap.top().due <= now) {
+        Pending pe = heap.top();
+        heap.pop();
+        if (opts_.throttle)
+          opts_.throttle->release(pe.probe.ticket, pe.out);
+        sink(pe.probe, pe.out);
+      }
+
+      // ── Sleep until the next reply (or the throttle tick) ──
+      if (!heap.empty()) {
+        auto wake = heap.top().due;
+        if (throttled)
+          wake = std::min(wake, now + std::chrono::milliseconds(kTickMs));
+        std::this_thread::sleep_until(wake);
+      }
+    }
+  }
+
+  EngineOptions opts_;
+  SimNetwork &net_;
+};
@@ -0,0 +1,336 @@
+/*
+ * socket_manager.h - Probe socket lifecycle for sustained connect rates
+ *
+ * A graceful close() parks every probe connection in TIME_WAIT for a
+ * minute; after a few minutes of a fast sweep the ephemeral port range is
+ * used up and connect() fails with EADDRNOTAVAIL. SocketManager owns the
+ * probe sockets of every engine from socket() to close():
+ *
+ *   - close() is abortive (SO_LINGER {1, 0}): the kernel answers with RST
+ *     and keeps no TIME_WAIT state, the handshake is all a scan needs
+ *   - sockets can be bound to several source addresses and/or a source
+ *     port range, multiplying the 4-tuples available per destination
+ *   - TCP_SYNCNT caps the kernel's SYN retransmits per socket (Linux)
+ *   - RLIMIT_NOFILE is raised to the hard limit at startup and live
+ *     sockets are counted against it
+ *
+ * When the fd budget, the kernel or the source ports run out, open() and
+ * connectTimed() report a shortage rather than a result; callers hold the
+ * probe and retry once sockets have been released, so a shortage slows
+ * the scan down instead of turning into false "closed" ports.
+ *
+ * A Transport (the simulated network) can stand in for the wire under
+ * connectTimed(), so the thread engine runs on it unchanged.
+ */
+#pragma once
+
+#include "transport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SocketManager {
+public:
+  struct Options {
+    std::vector<std::string> sourceAddrs; // bind here (rotating); empty = any
+    int portLo = 0, portHi = 0;           // source port range, 0 = ephemeral
+    int synRetries = 0;                   // TCP_SYNCNT, 0 = kernel default
+  };
+
+  // A shortage that lasts longer than this is reported as an error
+  static constexpr int kMaxStallMs = 5000;
+  // Descriptors kept free for files, epoll / io_uring instances, ...
+  static constexpr int kReservedFds = 64;
+
+  SocketManager() { budget_ = fdLimit() - kReservedFds; }
+
+  // Answers connectTimed() instead of the network: blocks as long as the
+  // reply takes and, for Open, sets the banner the service sends first
+  class Transport {
+  public:
+    virtual ~Transport() = default;
+    virtual net::ConnectStatus connect(const net::Endpoint &ep,
+                                       int timeoutMs, long &elapsedMs,
+                                       std::string &banner) = 0;
+  };
+
+  // Route connectTimed() through t; null = real sockets
+  void setTransport(Transport *t) { transport_ = t; }
+
+  // Raise the soft descriptor limit to the hard limit; returns the limit
+  static long raiseFdLimit() {
+#ifndef _WIN32
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+    }
+#endif
+    return fdLimit();
+  }
+
+  // Parse and test-bind the source addresses; false and err when unusable
+  bool configure(const Options &opts, std::string &err) {
+    opts_ = opts;
+    sources_.clear();
+    for (const std::string &addr : opts.sourceAddrs) {
+      net::Endpoint ep;
+      if (!net::makeEndpoint(addr, 0, ep)) {
+        err = "Bad source address: " + addr;
+        return false;
+      }
+      net::socket_t s = net::openTcpSocket(ep.family());
+      bool ok = s != net::kInvalidSocket && bind(s, ep.sa(), ep.len) == 0;
+      if (s != net::kInvalidSocket)
+        net::closeSocket(s);
+      if (!ok) {
+        err = "Cannot bind source address: " + addr;
+        return false;
+      }
+      sources_.push_back(ep);
+    }
+    bool badRange = opts.portLo > 0 &&
+                    (opts.portHi < opts.portLo || opts.portHi > 65535);
+    if (opts.portLo < 0 || badRange) {
+      err = "Bad source port range";
+      return false;
+    }
+    budget_ = fdLimit() - kReservedFds;
+    return true;
+  }
+
+  // Sockets that may be open at once
+  long budget() const { return budget_; }
+
+  // New TCP socket for a connect to dst, bound as configured. Returns
+  // kInvalidSocket with err set on failure; see isShortage().
+  net::socket_t open(const net::Endpoint &dst, int &err,
+                     bool nonBlocking = true) {
+    // Claim a place in the budget first so concurrent opens cannot
+    // overshoot it
+    uint64_t now = live_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((long)now > budget_) {
+      live_.fetch_sub(1, std::memory_order_relaxed);
+      err = kNoDescriptors;
+      noteShortage();
+      return net::kInvalidSocket;
+    }
+#ifdef __linux__
+    int type = SOCK_STREAM | SOCK_CLOEXEC | (nonBlocking ? SOCK_NONBLOCK : 0);
+    net::socket_t s = socket(dst.family(), type, IPPROTO_TCP);
+#else
+    net::socket_t s = net::openTcpSocket(dst.family());
+    if (s != net::kInvalidSocket && nonBlocking)
+      net::setNonBlocking(s, true);
+#endif
+    if (s == net::kInvalidSocket) {
+      err = net::lastError();
+      live_.fetch_sub(1, std::memory_order_relaxed);
+      if (isShortage(err))
+        noteShortage();
+      return net::kInvalidSocket;
+    }
+#ifdef TCP_SYNCNT
+    if (opts_.synRetries > 0)
+      setsockopt(s, IPPROTO_TCP, TCP_SYNCNT, &opts_.synRetries,
+                 sizeof(opts_.synRetries));
+#endif
+    if (!bindSource(s, dst.family(), err)) {
+      net::closeSocket(s);
+      live_.fetch_sub(1, std::memory_order_relaxed);
+      if (isShortage(err))
+        noteShortage();
+      return net::kInvalidSocket;
+    }
+    uint64_t peak = peak_.load(std::memory_order_relaxed);
+    while (now > peak && !peak_.compare_exchange_weak(
+                             peak, now, std::memory_order_relaxed)) {
+    }
+    return s;
+  }
+
+  // Abortive close of a socket from open()
+  void close(net::socket_t s) {
+    struct linger lg;
+    lg.l_onoff = 1;
+    lg.l_linger = 0;
+    setsockopt(s, SOL_SOCKET, SO_LINGER, (const char *)&lg, sizeof(lg));
+    net::closeSocket(s);
+    live_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // net::connectTimed() on a managed socket. Shortages are waited out
+  // (up to kMaxStallMs) instead of being reported. *sysErr (when given)
+  // receives the error behind a Refused or Error result.
+  net::ConnectStatus connectTimed(const net::Endpoint &ep, int timeoutMs,
+                                  long &elapsedMs,
+                                  net::socket_t *keepOpen = nullptr,
+                                  int *sysErr = nullptr) {
+    if (transport_)
+      return connectVia(ep, timeoutMs, elapsedMs, keepOpen);
+    auto giveUp = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(kMaxStallMs);
+    while (true) {
+      int err = 0;
+      elapsedMs = -1;
+      net::socket_t s = open(ep, err);
+      if (s != net::kInvalidSocket) {
+        net::ConnectStatus st = net::connectOn(s, ep, timeoutMs, elapsedMs,
+                                               &err);
+        if (sysErr)
+          *sysErr = err;
+        if (keepOpen && st == net::ConnectStatus::Open) {
+          *keepOpen = s;
+          return st;
+        }
+        close(s);
+        if (st != net::ConnectStatus::Error || !isShortage(err))
+          return st;
+        noteShortage();
+      }
+      if (!isShortage(err) || std::chrono::steady_clock::now() >= giveUp) {
+        if (sysErr)
+          *sysErr = err;
+        return net::ConnectStatus::Error;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  // Out of descriptors, kernel memory or source ports: worth retrying
+  static bool isShortage(int err) {
+#ifdef _WIN32
+    return err == WSAEMFILE || err == WSAENOBUFS || err == WSAEADDRINUSE ||
+           err == WSAEADDRNOTAVAIL;
+#else
+    return err == EMFILE || err == ENFILE || err == ENOBUFS ||
+           err == ENOMEM || err == EADDRINUSE || err == EADDRNOTAVAIL;
+#endif
+  }
+
+  // For callers that hit a shortage outside open() (e.g. in connect())
+  void noteShortage() { stalls_.fetch_add(1, std::memory_order_relaxed); }
+
+  uint64_t live() const { return live_.load(std::memory_order_relaxed); }
+  uint64_t peak() const { return peak_.load(std::memory_order_relaxed); }
+  uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+  void resetStats() {
+    peak_.store(live(), std::memory_order_relaxed);
+    stalls_.store(0, std::memory_order_relaxed);
+  }
+
+  // Prometheus text exposition, appended to the --metrics file
+  std::string prometheus() const {
+    std::ostringstream os;
+    os << "# HELP portscan_sockets_open Probe sockets currently open.\n"
+       << "# TYPE portscan_sockets_open gauge\n"
+       << "portscan_sockets_open " << live() << "\n"
+       << "# HELP portscan_sockets_budget Probe sockets allowed at once.\n"
+       << "# TYPE portscan_sockets_budget gauge\n"
+       << "portscan_sockets_budget " << budget_ << "\n"
+       << "# HELP portscan_socket_stalls_total Opens or connects deferred "
+          "for lack of descriptors or source ports.\n"
+       << "# TYPE portscan_socket_stalls_total counter\n"
+       << "portscan_socket_stalls_total " << stalls() << "\n";
+    return os.str();
+  }
+
+private:
+#ifdef _WIN32
+  static constexpr int kNoDescriptors = WSAEMFILE;
+#else
+  static constexpr int kNoDescriptors = EMFILE;
+#endif
+
+  // connectTimed() over the transport. A kept open connection is one end
+  // of a socketpair whose other end has sent the banner and closed, so
+  // the banner stage reads it like a real one.
+  net::ConnectStatus connectVia(const net::Endpoint &ep, int timeoutMs,
+                                long &elapsedMs, net::socket_t *keepOpen) {
+    std::string banner;
+    net::ConnectStatus st =
+        transport_->connect(ep, timeoutMs, elapsedMs, banner);
+#ifndef _WIN32
+    int pair[2];
+    if (keepOpen && st == net::ConnectStatus::Open &&
+        socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0) {
+      if (!banner.empty())
+        net::sendData(pair[1], banner.data(), (int)banner.size());
+      net::closeSocket(pair[1]);
+      live_.fetch_add(1, std::memory_order_relaxed); // close() takes it back
+      *keepOpen = pair[0];
+    }
+#endif
+    return st;
+  }
+
+  static long fdLimit() {
+#ifndef _WIN32
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+      return (long)std::min<rlim_t>(rl.rlim_cur, INT_MAX);
+#endif
+    return INT_MAX;
+  }
+
+  // Bind per options: rotate over the source addresses of the family and
+  // the port range. Nothing to do when neither is configured.
+  bool bindSource(net::socket_t s, int family, int &err) {
+    std::vector<const net::Endpoint *> addrs;
+    for (const net::Endpoint &ep : sources_)
+      if (ep.family() == family)
+        addrs.push_back(&ep);
+    bool ports = opts_.portLo > 0;
+    if (addrs.empty() && !ports)
+      return true;
+
+    // Ports turn fastest, then addresses: every (address, port) pair
+    // comes up once per cycle
+    uint64_t turn = next_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t range = ports ? (uint64_t)(opts_.portHi - opts_.portLo + 1) : 1;
+    net::Endpoint local;
+    if (!addrs.empty())
+      local = *addrs[(turn / range) % addrs.size()];
+    else
+      net::makeEndpoint(family == AF_INET6 ? "::" : "0.0.0.0", 0, local);
+
+    if (ports) {
+      // Every socket is SO_REUSEADDR, so bind() never fails on a port in
+      // use; a colliding 4-tuple shows up as EADDRNOTAVAIL from connect()
+      // and the retry takes the next port
+      net::setEndpointPort(local, opts_.portLo + (int)(turn % range));
+#ifndef _WIN32
+      int one = 1;
+      setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+#endif
+    } else {
+#ifdef IP_BIND_ADDRESS_NO_PORT
+      // Pick the port at connect() time, per destination, so one source
+      // address is not limited to one ephemeral range overall
+      int one = 1;
+      setsockopt(s, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+#endif
+    }
+
+    if (bind(s, local.sa(), local.len) != 0) {
+      err = net::lastError();
+      return false;
+    }
+    return true;
+  }
+
+  Options opts_;
+  Transport *transport_ = nullptr;
+  std::vector<net::Endpoint> sources_;
+  long budget_ = INT_MAX;
+  std::atomic<uint64_t> next_{0};
+  std::atomic<uint64_t> live_{0}, peak_{0}, stalls_{0};
+};
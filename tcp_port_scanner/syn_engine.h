@@ -0,0 +1,394 @@
+/*
+ * syn_engine.h - Raw-socket SYN ("half-open") scan engine (Linux, IPv4)
+ *
+ * No kernel connect at all: a sender thread writes hand-built SYN packets
+ * to a raw socket and a receiver thread reads the replies from another
+ * one. A SYN-ACK means open and is answered with an RST, so the
+ * handshake never completes; an RST means closed; silence until the
+ * probe's deadline means filtered. No socket, ephemeral port or
+ * TIME_WAIT slot is spent per probe.
+ *
+ * Replies are recognised statelessly: the SYN's sequence number is a
+ * keyed hash (cookie) of the target address and both ports, so a genuine
+ * reply acknowledges cookie + 1 and anything else is dropped. A classic
+ * BPF filter on the receive socket lets through only TCP segments for
+ * our source port, so the receiver does not see the host's other
+ * traffic. The only per-probe state is a small user-space entry that
+ * gives the pipeline its timeout.
+ *
+ * Needs root or CAP_NET_RAW; run() returns false when the raw sockets
+ * cannot be opened. The host's own stack also answers the SYN-ACK with
+ * an RST (no socket owns our source port), which is harmless.
+ */
+#pragma once
+
+#ifdef __linux__
+
+#include "scan_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <linux/filter.h>
+#include <mutex>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <queue>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class SynEngine {
+public:
+  explicit SynEngine(const EngineOptions &opts) : opts_(opts) {
+    std::random_device rd;
+    key_ = ((uint64_t)rd() << 32) ^ rd();
+    // Above the usual ephemeral range (32768-60999), so no local socket
+    // of ours is likely to own it
+    srcPort_ = (uint16_t)(61000 + rd() % 4500);
+  }
+
+  ~SynEngine() {
+    if (sendFd_ >= 0)
+      close(sendFd_);
+    if (recvFd_ >= 0)
+      close(recvFd_);
+  }
+
+  // False when raw sockets are not available (not root / no CAP_NET_RAW)
+  bool run(const ProbeSource &source, const ProbeSink &sink) {
+    sendFd_ = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_RAW);
+    recvFd_ = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                     IPPROTO_TCP);
+    if (sendFd_ < 0 || recvFd_ < 0)
+      return false;
+    int one = 1;
+    setsockopt(sendFd_, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one));
+    int rcvbuf = 8 << 20;
+    if (setsockopt(recvFd_, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf,
+                   sizeof(rcvbuf)) != 0)
+      setsockopt(recvFd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    attachFilter();
+
+    capacity_ = std::max(1, opts_.maxInFlight);
+    senderDone_ = false;
+    std::thread receiver([this, &sink] { receiveLoop(sink); });
+    sendLoop(source, sink);
+    receiver.join();
+    return true;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr int kTickMs = 5;
+
+  struct Pending {
+    Probe probe;
+    Clock::time_point sent;
+    uint64_t serial;
+  };
+  struct Deadline {
+    Clock::time_point due;
+    uint64_t key;
+    uint64_t serial;
+    bool operator>(const Deadline &o) const { return due > o.due; }
+  };
+
+  // 20-byte IP header + 20-byte TCP header + MSS option
+  struct Packet {
+    iphdr ip;
+    tcphdr tcp;
+    uint8_t options[4];
+  };
+
+  static uint64_t keyOf(uint32_t addr, uint16_t port) {
+    return ((uint64_t)addr << 16) | port;
+  }
+
+  // Keyed hash of the flow; the SYN's sequence number (addr/ports in
+  // network byte order, as they appear on the wire)
+  uint32_t cookie(uint32_t daddr, uint16_t dport) const {
+    uint64_t x = key_ ^ ((uint64_t)daddr << 32) ^ ((uint64_t)dport << 16) ^
+                 srcPort_;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return (uint32_t)x;
+  }
+
+  static uint16_t checksum(const void *data, size_t len, uint32_t sum = 0) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (; len > 1; len -= 2, p += 2)
+      sum += (uint32_t)((p[0] << 8) | p[1]);
+    if (len)
+      sum += (uint32_t)(p[0] << 8);
+    while (sum >> 16)
+      sum = (sum & 0xFFFF) + (sum >> 16);
+    return htons((uint16_t)~sum);
+  }
+
+  // Accept only unfragmented TCP to our source port
+  void attachFilter() {
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9), // protocol
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 5),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6), // fragment offset
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1FFF, 3, 0),
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0), // x = IP header length
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2),  // TCP destination port
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, srcPort_, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0xFFFF),
+    };
+    sock_fprog prog = {(unsigned short)(sizeof(code) / sizeof(code[0])), code};
+    setsockopt(recvFd_, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+  }
+
+  // Local address the kernel would route daddr from (network order)
+  uint32_t sourceFor(uint32_t daddr) {
+    auto it = sources_.find(daddr);
+    if (it != sources_.end())
+      return it->second;
+    uint32_t saddr = 0;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(9);
+    sa.sin_addr.s_addr = daddr;
+    socklen_t len = sizeof(sa);
+    if (fd >= 0 && connect(fd, (sockaddr *)&sa, sizeof(sa)) == 0 &&
+        getsockname(fd, (sockaddr *)&sa, &len) == 0)
+      saddr = sa.sin_addr.s_addr;
+    if (fd >= 0)
+      close(fd);
+    sources_[daddr] = saddr;
+    return saddr;
+  }
+
+  bool sendSegment(uint32_t saddr, uint32_t daddr, uint16_t dport,
+                   uint32_t seq, bool syn) {
+    Packet pkt;
+    std::memset(&pkt, 0, sizeof(pkt));
+    size_t tcpLen = syn ? sizeof(tcphdr) + sizeof(pkt.options) : sizeof(tcphdr);
+    pkt.ip.version = 4;
+    pkt.ip.ihl = 5;
+    pkt.ip.tot_len = htons((uint16_t)(sizeof(iphdr) + tcpLen));
+    pkt.ip.ttl = 64;
+    pkt.ip.protocol = IPPROTO_TCP;
+    pkt.ip.saddr = saddr;
+    pkt.ip.daddr = daddr; // id and IP checksum are filled in by the kernel
+
+    pkt.tcp.source = htons(srcPort_);
+    pkt.tcp.dest = dport;
+    pkt.tcp.seq = htonl(seq);
+    pkt.tcp.doff = (uint16_t)(tcpLen / 4);
+    if (syn) {
+      pkt.tcp.syn = 1;
+      pkt.tcp.window = htons(1024);
+      pkt.options[0] = 2; // MSS 1460
+      pkt.options[1] = 4;
+      pkt.options[2] = 1460 >> 8;
+      pkt.options[3] = 1460 & 0xFF;
+    } else {
+      pkt.tcp.rst = 1;
+    }
+
+    struct {
+      uint32_t saddr, daddr;
+      uint8_t zero, proto;
+      uint16_t len;
+    } pseudo = {saddr, daddr, 0, IPPROTO_TCP, htons((uint16_t)tcpLen)};
+    uint32_t sum = 0;
+    const uint8_t *ps = (const uint8_t *)&pseudo;
+    for (size_t i = 0; i < sizeof(pseudo); i += 2)
+      sum += (uint32_t)((ps[i] << 8) | ps[i + 1]);
+    pkt.tcp.check = checksum(&pkt.tcp, tcpLen, sum);
+
+    sockaddr_in to{};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = daddr;
+    size_t total = sizeof(iphdr) + tcpLen;
+    for (int attempt = 0; attempt < 100; attempt++) {
+      if (sendto(sendFd_, &pkt, total, 0, (sockaddr *)&to, sizeof(to)) ==
+          (ssize_t)total)
+        return true;
+      if (errno != ENOBUFS && errno != EAGAIN)
+        return false;
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return false;
+  }
+
+  // Removes the entry for key; false if it already completed
+  bool take(uint64_t key, uint64_t serial, Pending &out) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = pending_.find(key);
+    if (it == pending_.end() || (serial && it->second.serial != serial))
+      return false;
+    out = std::move(it->second);
+    pending_.erase(it);
+    room_.notify_one();
+    return true;
+  }
+
+  void complete(const ProbeSink &sink, const Probe &p, net::ConnectStatus s,
+                Clock::time_point sent) {
+    ProbeOutcome out;
+    out.status = s;
+    if (sent != Clock::time_point()) {
+      out.elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                          Clock::now() - sent)
+                          .count();
+      out.elapsedMs = (long)(out.elapsedUs / 1000);
+    }
+    if (opts_.throttle)
+      opts_.throttle->release(p.ticket, out);
+    sink(p, out);
+  }
+
+  void sendLoop(const ProbeSource &source, const ProbeSink &sink) {
+    uint64_t serial = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        room_.wait(lock, [this] { return (int)pending_.size() < capacity_; });
+      }
+      uint64_t ticket = 0;
+      if (opts_.throttle && !opts_.throttle->tryAcquire(ticket)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      Probe p;
+      if (!source(p)) {
+        if (opts_.throttle)
+          opts_.throttle->cancel(ticket);
+        break;
+      }
+      p.ticket = ticket;
+
+      if (p.ep.family() != AF_INET) { // IPv6 is not crafted here
+        complete(sink, p, net::ConnectStatus::Error, Clock::time_point());
+        continue;
+      }
+      const sockaddr_in *v4 = (const sockaddr_in *)&p.ep.addr;
+      uint32_t daddr = v4->sin_addr.s_addr;
+      uint16_t dport = htons((uint16_t)p.port);
+      uint32_t saddr = sourceFor(daddr);
+      uint64_t key = keyOf(daddr, dport);
+      int timeoutMs = p.timeoutMs > 0 ? p.timeoutMs : opts_.timeoutMs;
+
+      auto now = Clock::now();
+      bool duplicate;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        duplicate = pending_.count(key) != 0;
+        if (!duplicate && saddr) {
+          pending_[key] = Pending{p, now, ++serial};
+          deadlines_.push(Deadline{
+              now + std::chrono::milliseconds(timeoutMs), key, serial});
+        }
+      }
+      if (duplicate || !saddr) {
+        complete(sink, p, net::ConnectStatus::Error, Clock::time_point());
+        continue;
+      }
+      if (!sendSegment(saddr, daddr, dport, cookie(daddr, dport), true)) {
+        Pending pe;
+        if (take(key, serial, pe))
+          complete(sink, pe.probe, net::ConnectStatus::Error,
+                   Clock::time_point());
+      }
+    }
+    senderDone_ = true;
+  }
+
+  void receiveLoop(const ProbeSink &sink) {
+    uint8_t buf[1500];
+    std::vector<std::pair<Pending, net::ConnectStatus>> done;
+
+    while (true) {
+      net::pollfd_t pfd;
+      pfd.fd = recvFd_;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      net::pollSockets(&pfd, 1, kTickMs);
+
+      // ── Match replies ──
+      while (true) {
+        ssize_t n = recv(recvFd_, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < (ssize_t)sizeof(iphdr))
+          break;
+        const iphdr *ip = (const iphdr *)buf;
+        size_t ihl = (size_t)ip->ihl * 4;
+        if (ip->protocol != IPPROTO_TCP || (size_t)n < ihl + sizeof(tcphdr))
+          continue;
+        const tcphdr *tcp = (const tcphdr *)(buf + ihl);
+        if (ntohs(tcp->dest) != srcPort_ || !tcp->ack ||
+            ntohl(tcp->ack_seq) != cookie(ip->saddr, tcp->source) + 1)
+          continue;
+
+        net::ConnectStatus status;
+        if (tcp->syn) {
+          status = net::ConnectStatus::Open;
+          // Tear the half-open connection down instead of completing it
+          sendSegment(ip->daddr, ip->saddr, tcp->source, ntohl(tcp->ack_seq),
+                      false);
+        } else if (tcp->rst) {
+          status = net::ConnectStatus::Refused;
+        } else {
+          continue;
+        }
+        Pending pe;
+        if (take(keyOf(ip->saddr, tcp->source), 0, pe))
+          done.push_back({std::move(pe), status});
+      }
+
+      // ── Expire probes nobody answered ──
+      auto now = Clock::now();
+      bool finished;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        while (!deadlines_.empty() && deadlines_.top().due <= now) {
+          Deadline d = deadlines_.top();
+          deadlines_.pop();
+          auto it = pending_.find(d.key);
+          if (it == pending_.end() || it->second.serial != d.serial)
+            continue;
+          done.push_back({std::move(it->second),
+                          net::ConnectStatus::TimedOut});
+          pending_.erase(it);
+        }
+        if (!done.empty())
+          room_.notify_one();
+        finished = senderDone_ && pending_.empty();
+      }
+
+      for (auto &d : done)
+        complete(sink, d.first.probe, d.second, d.first.sent);
+      done.clear();
+      if (finished)
+        return;
+    }
+  }
+
+  EngineOptions opts_;
+  uint64_t key_;
+  uint16_t srcPort_;
+  int sendFd_ = -1;
+  int recvFd_ = -1;
+  int capacity_ = 1;
+  std::atomic<bool> senderDone_{false};
+
+  std::mutex mtx_; // pending_ and deadlines_
+  std::condition_variable room_;
+  std::unordered_map<uint64_t, Pending> pending_;
+  std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>
+      deadlines_;
+  std::unordered_map<uint32_t, uint32_t> sources_; // sender thread only
+};
+
+#endif // __linux__
@@ -0,0 +1,505 @@
+/*
+ * targets.h - Target specifications and the lazy (host, port) generator
+ *
+ * A TargetSet stores what the user asked for in compact form: IPv4
+ * ranges (from single addresses, CIDR blocks and a.b.c.d-e ranges) plus
+ * individual IPv6 addresses and resolved hostnames. Hosts are addressed
+ * by a dense index, so a /16 costs one range entry, not 65536 strings.
+ *
+ * PortSet holds a port specification as a 65536-bit bitmap.
+ *
+ * ProbeGenerator walks the host x port space by index and builds each
+ * Probe on demand; nothing is materialised up front, so memory stays
+ * flat no matter how many probes a job contains. An optional Feistel
+ * permutation shuffles the visiting order, an optional host mask (from
+ * host discovery) leaves out every probe of the hosts not in it, and a
+ * Shard keeps only this process's slice of a job split with --shard.
+ */
+#pragma once
+
+#include "permutation.h"
+#include "scan_engine.h"
+#include "transport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ─────────────────────────────────────────────
+//  Target Set
+// ─────────────────────────────────────────────
+class TargetSet {
+public:
+  // Add one comma-separated spec. Accepted forms per item:
+  //   10.0.0.1   10.0.0.0/16   10.0.0.1-10.0.3.255   10.0.0.1-50
+  //   2001:db8::1   scanme.example.org
+  // Hostnames are resolved with `resolve`, which returns every address of
+  // the name (empty when unknown); each becomes a host. Returns false and
+  // sets err on the first item that cannot be used.
+  template <class Resolver>
+  bool addSpec(const std::string &spec, Resolver &&resolve, std::string &err) {
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      item.erase(0, item.find_first_not_of(" \t\r"));
+      item.erase(item.find_last_not_of(" \t\r") + 1);
+      if (item.empty())
+        continue;
+      if (!addItem(item, resolve)) {
+        err = item;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Target file: one spec per line, '#' starts a comment
+  template <class Resolver>
+  bool addFile(const std::string &path, Resolver &&resolve, std::string &err) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+      err = path;
+      return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      size_t hash = line.find('#');
+      if (hash != std::string::npos)
+        line.erase(hash);
+      if (!addSpec(line, resolve, err))
+        return false;
+    }
+    return true;
+  }
+
+  uint64_t hostCount() const { return v4Total_ + v6_.size(); }
+  bool empty() const { return hostCount() == 0; }
+
+  // Endpoint of host #idx with port 0
+  void endpoint(uint64_t idx, net::Endpoint &ep) const {
+    std::memset(&ep.addr, 0, sizeof(ep.addr));
+    if (idx < v4Total_) {
+      sockaddr_in *v4 = (sockaddr_in *)&ep.addr;
+      v4->sin_family = AF_INET;
+      v4->sin_addr.s_addr = htonl(v4At(idx));
+      ep.len = sizeof(sockaddr_in);
+    } else {
+      sockaddr_in6 *v6 = (sockaddr_in6 *)&ep.addr;
+      v6->sin6_family = AF_INET6;
+      std::memcpy(&v6->sin6_addr, v6_[(size_t)(idx - v4Total_)].bytes, 16);
+      ep.len = sizeof(sockaddr_in6);
+    }
+  }
+
+  // Printable address of host #idx
+  std::string hostString(uint64_t idx) const {
+    char buf[INET6_ADDRSTRLEN] = {};
+    if (idx < v4Total_) {
+      uint32_t be = htonl(v4At(idx));
+      inet_ntop(AF_INET, &be, buf, sizeof(buf));
+    } else {
+      inet_ntop(AF_INET6, v6_[(size_t)(idx - v4Total_)].bytes, buf,
+                sizeof(buf));
+    }
+    return buf;
+  }
+
+private:
+  struct V4Range {
+    uint32_t lo, hi; // host byte order, inclusive
+    uint64_t first;  // index of `lo` in the host numbering
+  };
+  struct V6Addr {
+    unsigned char bytes[16];
+  };
+
+  template <class Resolver>
+  bool addItem(const std::string &item, Resolver &&resolve) {
+    uint32_t a, b;
+    size_t slash = item.find('/');
+    if (slash != std::string::npos) {
+      int bits;
+      try {
+        bits = std::stoi(item.substr(slash + 1));
+      } catch (...) {
+        return false;
+      }
+      if (!parseV4(item.substr(0, slash), a) || bits < 0 || bits > 32)
+        return false;
+      uint32_t mask = bits == 0 ? 0 : 0xFFFFFFFFu << (32 - bits);
+      addRange(a & mask, (a & mask) | ~mask);
+      return true;
+    }
+
+    size_t dash = item.find('-');
+    if (dash != std::string::npos && parseV4(item.substr(0, dash), a)) {
+      std::string rest = item.substr(dash + 1);
+      if (!parseV4(rest, b)) {
+        // Short form: 10.0.0.1-50 replaces the last octet
+        int last;
+        try {
+          last = std::stoi(rest);
+        } catch (...) {
+          return false;
+        }
+        if (last < 0 || last > 255)
+          return false;
+        b = (a & 0xFFFFFF00u) | (uint32_t)last;
+      }
+      if (a > b)
+        std::swap(a, b);
+      addRange(a, b);
+      return true;
+    }
+
+    if (parseV4(item, a)) {
+      addRange(a, a);
+      return true;
+    }
+
+    V6Addr v6;
+    if (inet_pton(AF_INET6, item.c_str(), v6.bytes) == 1) {
+      v6_.push_back(v6);
+      return true;
+    }
+
+    // Hostname: every address it resolved to becomes a host
+    std::vector<std::string> ips = resolve(item);
+    if (ips.empty())
+      return false;
+    for (const std::string &ip : ips) {
+      if (parseV4(ip, a))
+        addRange(a, a);
+      else if (inet_pton(AF_INET6, ip.c_str(), v6.bytes) == 1)
+        v6_.push_back(v6);
+      else
+        return false;
+    }
+    return true;
+  }
+
+  static bool parseV4(const std::string &s, uint32_t &out) {
+    in_addr addr;
+    if (inet_pton(AF_INET, s.c_str(), &addr) != 1)
+      return false;
+    out = ntohl(addr.s_addr);
+    return true;
+  }
+
+  void addRange(uint32_t lo, uint32_t hi) {
+    // Extend the previous range when contiguous (e.g. a list of IPs)
+    if (!v4_.empty() && v4_.back().hi != 0xFFFFFFFFu &&
+        v4_.back().hi + 1 == lo) {
+      v4_.back().hi = hi;
+    } else {
+      v4_.push_back(V4Range{lo, hi, v4Total_});
+    }
+    v4Total_ += (uint64_t)(hi - lo) + 1;
+  }
+
+  uint32_t v4At(uint64_t idx) const {
+    // Last range whose first index is <= idx
+    auto it = std::upper_bound(
+        v4_.begin(), v4_.end(), idx,
+        [](uint64_t v, const V4Range &r) { return v < r.first; });
+    --it;
+    return it->lo + (uint32_t)(idx - it->first);
+  }
+
+  std::vector<V4Range> v4_;
+  uint64_t v4Total_ = 0;
+  std::vector<V6Addr> v6_;
+};
+
+// ─────────────────────────────────────────────
+//  Port Set
+// ─────────────────────────────────────────────
+class PortSet {
+public:
+  PortSet() { std::memset(words_, 0, sizeof(words_)); }
+
+  void add(int port) { addRange(port, port); }
+
+  // Inclusive; fills whole words at a time
+  void addRange(int lo, int hi) {
+    lo = std::max(lo, 0);
+    hi = std::min(hi, 65535);
+    while (lo <= hi) {
+      int bit = lo % 64;
+      int n = std::min(64 - bit, hi - lo + 1);
+      uint64_t mask = n == 64 ? ~0ull : ((1ull << n) - 1) << bit;
+      words_[lo / 64] |= mask;
+      lo += n;
+    }
+  }
+
+  bool contains(int port) const {
+    return port >= 0 && port <= 65535 && ((words_[port / 64] >> (port % 64)) & 1);
+  }
+
+  size_t count() const {
+    size_t n = 0;
+    for (uint64_t w : words_)
+      n += (size_t)__builtin_popcountll(w);
+    return n;
+  }
+
+  bool empty() const { return count() == 0; }
+
+  // Calls f(port) for every member in ascending order
+  template <class F> void forEach(F &&f) const {
+    for (int i = 0; i < kWords; i++) {
+      uint64_t w = words_[i];
+      while (w) {
+        f(i * 64 + __builtin_ctzll(w));
+        w &= w - 1; // clear lowest set bit
+      }
+    }
+  }
+
+  std::vector<int> toVector() const {
+    std::vector<int> ports;
+    ports.reserve(count());
+    forEach([&](int p) { ports.push_back(p); });
+    return ports;
+  }
+
+private:
+  static constexpr int kWords = 65536 / 64;
+  uint64_t words_[kWords];
+};
+
+// ─────────────────────────────────────────────
+//  Probe Index Set
+// ─────────────────────────────────────────────
+// One bit per probe index; set() is safe to call from any thread.
+class ProbeSet {
+public:
+  explicit ProbeSet(uint64_t size)
+      : size_(size), words_((size_t)((size + 63) / 64)) {
+    for (auto &w : words_)
+      w.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t size() const { return size_; }
+
+  void set(uint64_t i) {
+    words_[(size_t)(i / 64)].fetch_or(1ull << (i % 64),
+                                      std::memory_order_relaxed);
+  }
+
+  bool test(uint64_t i) const {
+    return (words_[(size_t)(i / 64)].load(std::memory_order_relaxed) >>
+            (i % 64)) & 1;
+  }
+
+  uint64_t count() const {
+    uint64_t n = 0;
+    for (const auto &w : words_)
+      n += (uint64_t)__builtin_popcountll(w.load(std::memory_order_relaxed));
+    return n;
+  }
+
+  // Raw 64-bit words, for saving and restoring the set
+  size_t wordCount() const { return words_.size(); }
+  uint64_t word(size_t w) const {
+    return words_[w].load(std::memory_order_relaxed);
+  }
+  void setWord(size_t w, uint64_t bits) {
+    words_[w].store(bits, std::memory_order_relaxed);
+  }
+
+  // Calls f(i) for every member in ascending order
+  template <class F> void forEach(F &&f) const {
+    for (size_t w = 0; w < words_.size(); w++) {
+      uint64_t bits = word(w);
+      while (bits) {
+        f((uint64_t)w * 64 + (uint64_t)__builtin_ctzll(bits));
+        bits &= bits - 1;
+      }
+    }
+  }
+
+  // Every index in [0, size) that is not in `other`
+  void assignComplement(const ProbeSet &other) {
+    for (size_t w = 0; w < words_.size(); w++)
+      setWord(w, ~other.word(w));
+    if (size_ % 64)
+      setWord(words_.size() - 1,
+              word(words_.size() - 1) & ((1ull << (size_ % 64)) - 1));
+  }
+
+private:
+  uint64_t size_;
+  std::vector<std::atomic<uint64_t>> words_;
+};
+
+// ─────────────────────────────────────────────
+//  Shards
+// ─────────────────────────────────────────────
+// --shard i/N splits one job across processes without coordination: a
+// probe belongs to shard (hash(host address) + port) mod N. The address
+// and port number, not their positions, decide, so the split does not
+// depend on target or port order; consecutive ports of a host fall on
+// consecutive shards, so every shard gets an even slice of every host.
+// Host discovery is not coordinated: each shard pings the hosts it owns
+// probes on, so with N or more ports every shard pings every host.
+struct Shard {
+  uint32_t index = 0; // 0-based; printed 1-based
+  uint32_t count = 1;
+
+  bool all() const { return count <= 1; }
+  bool operator==(const Shard &o) const {
+    return index == o.index && count == o.count;
+  }
+
+  uint32_t of(const net::Endpoint &host, int port) const {
+    return (uint32_t)((hostKey(host) + (uint64_t)port) % count);
+  }
+  bool owns(const net::Endpoint &host, int port) const {
+    return all() || of(host, port) == index;
+  }
+
+  // 64-bit mix of the address bytes (splitmix64 finaliser per word).
+  // Words are read big-endian so every machine splits a job the same way.
+  static uint64_t hostKey(const net::Endpoint &host) {
+    const unsigned char *b;
+    size_t n;
+    if (host.family() == AF_INET) {
+      b = (const unsigned char *)&((const sockaddr_in *)&host.addr)->sin_addr;
+      n = 4;
+    } else {
+      b = (const unsigned char *)&((const sockaddr_in6 *)&host.addr)
+              ->sin6_addr;
+      n = 16;
+    }
+    uint64_t h = 0;
+    for (size_t off = 0; off < n; off += 4) {
+      uint32_t w = (uint32_t)b[off] << 24 | (uint32_t)b[off + 1] << 16 |
+                   (uint32_t)b[off + 2] << 8 | (uint32_t)b[off + 3];
+      h += w + 0x9E3779B97F4A7C15ull;
+      h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+      h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+      h ^= h >> 31;
+    }
+    return h;
+  }
+};
+
+// ─────────────────────────────────────────────
+//  Lazy Probe Generator
+// ─────────────────────────────────────────────
+// Probe index i maps to port ports[i / hosts] on host i % hosts, so
+// consecutive probes are spread across hosts instead of hammering one.
+// With `order`, the k-th probe handed out is index order(k) instead
+// (randomised scan). With `only`, just the indices in that set are
+// handed out (retry pass). With `hostsUp` (one bit per host index), only
+// probes of those hosts are handed out, and with `shard` only the probes
+// that shard owns.
+class ProbeGenerator {
+public:
+  ProbeGenerator(const TargetSet &targets, const std::vector<int> &ports,
+                 const ProbeSet *only = nullptr,
+                 const FeistelPermutation *order = nullptr,
+                 const ProbeSet *hostsUp = nullptr, Shard shard = Shard())
+      : targets_(targets), ports_(ports), hosts_(targets.hostCount()),
+        span_(hosts_ * ports.size()), only_(only), order_(order),
+        hostsUp_(hostsUp), shard_(shard), total_(countTotal()) {}
+
+  // Number of probes this generator hands out
+  uint64_t total() const { return total_; }
+
+  // Size of the full probe index space
+  uint64_t span() const { return span_; }
+
+  // Thread-safe; false once every probe has been handed out
+  bool next(Probe &p) {
+    while (true) {
+      uint64_t k = cursor_.fetch_add(1, std::memory_order_relaxed);
+      if (k >= span_)
+        return false;
+      if (at(k, p))
+        return true;
+    }
+  }
+
+  // Probe at position k (< span()) of the visiting order; false when
+  // that index is excluded by `only`, `hostsUp` or `shard`. For callers
+  // that split [0, span()) among themselves instead of sharing next().
+  bool at(uint64_t k, Probe &p) const {
+    uint64_t i = order_ ? (*order_)(k) : k;
+    if (only_ && !only_->test(i))
+      return false;
+    if (hostsUp_ && !hostsUp_->test(i % hosts_))
+      return false;
+    build(i, p);
+    return shard_.owns(p.ep, p.port);
+  }
+
+  void build(uint64_t i, Probe &p) const {
+    p.id = i;
+    p.timeoutMs = 0;
+    p.port = ports_[(size_t)(i / hosts_)];
+    targets_.endpoint(i % hosts_, p.ep);
+    net::setEndpointPort(p.ep, p.port);
+  }
+
+  uint64_t hostIndex(const Probe &p) const { return p.id % hosts_; }
+
+private:
+  uint64_t countTotal() const {
+    if (!shard_.all())
+      return countShard();
+    if (!hostsUp_)
+      return only_ ? only_->count() : span_;
+    if (!only_)
+      return hostsUp_->count() * ports_.size();
+    uint64_t n = 0;
+    only_->forEach([&](uint64_t i) { n += hostsUp_->test(i % hosts_); });
+    return n;
+  }
+
+  // Per host, the ports whose residue mod N lands on this shard; with
+  // `only`, one test per index in the set
+  uint64_t countShard() const {
+    uint64_t n = 0;
+    uint32_t c = shard_.count;
+    net::Endpoint ep;
+    auto up = [&](uint64_t h) { return !hostsUp_ || hostsUp_->test(h); };
+    if (only_) {
+      only_->forEach([&](uint64_t i) {
+        if (!up(i % hosts_))
+          return;
+        targets_.endpoint(i % hosts_, ep);
+        n += shard_.owns(ep, ports_[(size_t)(i / hosts_)]);
+      });
+      return n;
+    }
+    std::vector<uint64_t> residue(c, 0);
+    for (int port : ports_)
+      residue[(size_t)port % c]++;
+    for (uint64_t h = 0; h < hosts_; h++) {
+      if (!up(h))
+        continue;
+      targets_.endpoint(h, ep);
+      n += residue[(shard_.index + c - Shard::hostKey(ep) % c) % c];
+    }
+    return n;
+  }
+
+  const TargetSet &targets_;
+  const std::vector<int> &ports_;
+  uint64_t hosts_;
+  uint64_t span_;
+  const ProbeSet *only_;
+  const FeistelPermutation *order_;
+  const ProbeSet *hostsUp_;
+  Shard shard_;
+  uint64_t total_;
+  std::atomic<uint64_t> cursor_{0};
+};
@@ -0,0 +1,451 @@
+/*
+ * transport.h - Portable socket layer for the TCP port scanner
+ *
+ * Wraps the handful of socket primitives the scanner needs so that the
+ * scan logic in port_scanner.cpp is identical on Windows (Winsock2) and
+ * POSIX systems (Linux, BSD, macOS):
+ *
+ *   Windows : WSAStartup, SOCKET, ioctlsocket(FIONBIO), select, closesocket
+ *   POSIX   : int fds, fcntl(O_NONBLOCK), poll, close
+ *
+ * Everything is header-only and inline; include it instead of the raw
+ * platform socket headers.
+ */
+#pragma once
+
+#ifdef _WIN32
+/* winsock2.h MUST be included before windows.h */
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace net {
+
+// ─────────────────────────────────────────────
+//  Native Socket Handle
+// ─────────────────────────────────────────────
+#ifdef _WIN32
+using socket_t = SOCKET;
+using pollfd_t = WSAPOLLFD;
+const socket_t kInvalidSocket = INVALID_SOCKET;
+#else
+using socket_t = int;
+using pollfd_t = struct pollfd;
+const socket_t kInvalidSocket = -1;
+#endif
+
+// Outcome of a single non-blocking connect attempt
+enum class ConnectStatus {
+  Open,     // handshake completed (SO_ERROR == 0)
+  Refused,  // RST received / SO_ERROR set
+  TimedOut, // no answer before the deadline
+  Error     // local failure (socket(), fd limits, ...)
+};
+
+// ─────────────────────────────────────────────
+//  Library Init / Cleanup
+// ─────────────────────────────────────────────
+inline bool startup() {
+#ifdef _WIN32
+  WSADATA wsaData;
+  return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+  return true;
+#endif
+}
+
+inline void cleanup() {
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+// ─────────────────────────────────────────────
+//  Socket Primitives
+// ─────────────────────────────────────────────
+inline int lastError() {
+#ifdef _WIN32
+  return WSAGetLastError();
+#else
+  return errno;
+#endif
+}
+
+inline socket_t openTcpSocket(int family = AF_INET) {
+  return socket(family, SOCK_STREAM, IPPROTO_TCP);
+}
+
+inline void closeSocket(socket_t sock) {
+#ifdef _WIN32
+  closesocket(sock);
+#else
+  close(sock);
+#endif
+}
+
+inline bool setNonBlocking(socket_t sock, bool enable) {
+#ifdef _WIN32
+  u_long mode = enable ? 1 : 0;
+  return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0)
+    return false;
+  flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  return fcntl(sock, F_SETFL, flags) == 0;
+#endif
+}
+
+// Send/receive timeouts for blocking sockets
+inline void setIoTimeouts(socket_t sock, int timeoutMs) {
+#ifdef _WIN32
+  DWORD timeout = (DWORD)timeoutMs;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout,
+             sizeof(timeout));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout,
+             sizeof(timeout));
+#else
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+// Pending error of a connecting socket (0 = connected)
+inline int pendingError(socket_t sock) {
+  int error = 0;
+#ifdef _WIN32
+  int errLen = sizeof(error);
+  getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&error, &errLen);
+#else
+  socklen_t errLen = sizeof(error);
+  if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &errLen) != 0)
+    return errno;
+#endif
+  return error;
+}
+
+// True when a non-blocking connect() is still in progress
+inline bool connectPending(int err) {
+#ifdef _WIN32
+  return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+#else
+  return err == EINPROGRESS || err == EINTR;
+#endif
+}
+
+// Map a connect() errno / SO_ERROR value to a scan outcome: anything the
+// remote side (or a router on the path) answered is Refused, the rest is a
+// local Error.
+inline ConnectStatus classifyConnectError(int err) {
+  if (err == 0)
+    return ConnectStatus::Open;
+#ifdef _WIN32
+  switch (err) {
+  case WSAECONNREFUSED:
+  case WSAENETUNREACH:
+  case WSAEHOSTUNREACH:
+    return ConnectStatus::Refused;
+  case WSAETIMEDOUT:
+    return ConnectStatus::TimedOut;
+  }
+#else
+  switch (err) {
+  case ECONNREFUSED:
+  case ECONNRESET:
+  case ENETUNREACH:
+  case EHOSTUNREACH:
+    return ConnectStatus::Refused;
+  case ETIMEDOUT:
+    return ConnectStatus::TimedOut;
+  }
+#endif
+  return ConnectStatus::Error;
+}
+
+// A connect that completed asynchronously (writable, SO_ERROR read): the
+// SYN went out, so an error without a status of its own is still the
+// target's answer and counts as Refused. Shared by every engine that
+// waits for the handshake, so they report a port the same way.
+inline ConnectStatus classifyPendingError(int err) {
+  ConnectStatus status = classifyConnectError(err);
+  return status == ConnectStatus::Error ? ConnectStatus::Refused : status;
+}
+
+// Refusals that came from an ICMP unreachable (a router on the path, or
+// no route at all) rather than from the destination host itself
+inline bool unreachableError(int err) {
+#ifdef _WIN32
+  return err == WSAENETUNREACH || err == WSAEHOSTUNREACH;
+#else
+  return err == ENETUNREACH || err == EHOSTUNREACH;
+#endif
+}
+
+// Wait until the socket is writable (connect finished). Returns >0 when
+// ready, 0 on timeout, <0 on error.
+inline int waitWritable(socket_t sock, int timeoutMs) {
+#ifdef _WIN32
+  fd_set wset, eset;
+  FD_ZERO(&wset);
+  FD_ZERO(&eset);
+  FD_SET(sock, &wset);
+  FD_SET(sock, &eset); // Winsock reports failed connects via exceptfds
+
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  return select(0, nullptr, &wset, &eset, &tv);
+#else
+  struct pollfd pfd;
+  pfd.fd = sock;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  int rc;
+  do {
+    rc = poll(&pfd, 1, timeoutMs);
+  } while (rc < 0 && errno == EINTR);
+  return rc;
+#endif
+}
+
+// poll() over several sockets; returns the number ready, 0 on timeout
+inline int pollSockets(pollfd_t *fds, size_t count, int timeoutMs) {
+  if (count == 0)
+    return 0;
+#ifdef _WIN32
+  return WSAPoll(fds, (ULONG)count, timeoutMs);
+#else
+  int rc;
+  do {
+    rc = poll(fds, (nfds_t)count, timeoutMs);
+  } while (rc < 0 && errno == EINTR);
+  return rc;
+#endif
+}
+
+inline int sendData(socket_t sock, const char *data, int len) {
+#ifdef _WIN32
+  return send(sock, data, len, 0);
+#else
+  return (int)send(sock, data, (size_t)len, MSG_NOSIGNAL);
+#endif
+}
+
+inline int recvData(socket_t sock, char *buf, int len) {
+#ifdef _WIN32
+  return recv(sock, buf, len, 0);
+#else
+  return (int)recv(sock, buf, (size_t)len, 0);
+#endif
+}
+
+// ─────────────────────────────────────────────
+//  Addressing
+// ─────────────────────────────────────────────
+// Socket address of one probe destination (IPv4 or IPv6)
+struct Endpoint {
+  sockaddr_storage addr;
+  socklen_t len = 0;
+
+  int family() const { return addr.ss_family; }
+  const sockaddr *sa() const { return (const sockaddr *)&addr; }
+};
+
+inline bool makeEndpoint(const std::string &ip, int port, Endpoint &ep) {
+  std::memset(&ep.addr, 0, sizeof(ep.addr));
+  sockaddr_in *v4 = (sockaddr_in *)&ep.addr;
+  if (inet_pton(AF_INET, ip.c_str(), &v4->sin_addr) == 1) {
+    v4->sin_family = AF_INET;
+    v4->sin_port = htons((unsigned short)port);
+    ep.len = sizeof(sockaddr_in);
+    return true;
+  }
+  sockaddr_in6 *v6 = (sockaddr_in6 *)&ep.addr;
+  if (inet_pton(AF_INET6, ip.c_str(), &v6->sin6_addr) == 1) {
+    v6->sin6_family = AF_INET6;
+    v6->sin6_port = htons((unsigned short)port);
+    ep.len = sizeof(sockaddr_in6);
+    return true;
+  }
+  ep.len = 0;
+  return false;
+}
+
+// Rewrite only the port of an already-built endpoint
+inline void setEndpointPort(Endpoint &ep, int port) {
+  if (ep.family() == AF_INET6)
+    ((sockaddr_in6 *)&ep.addr)->sin6_port = htons((unsigned short)port);
+  else
+    ((sockaddr_in *)&ep.addr)->sin_port = htons((unsigned short)port);
+}
+
+// Resolve hostname to dotted IPv4 string ("" on failure)
+inline std::string resolveIPv4(const std::string &host) {
+  struct addrinfo hints{}, *res = nullptr;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res)
+    return "";
+
+  char ipStr[INET_ADDRSTRLEN];
+  struct sockaddr_in *addr = (struct sockaddr_in *)res->ai_addr;
+  inet_ntop(AF_INET, &addr->sin_addr, ipStr, sizeof(ipStr));
+  freeaddrinfo(res);
+  return std::string(ipStr);
+}
+
+// Every address of a hostname, IPv4 first, without duplicates
+inline std::vector<std::string> resolveAll(const std::string &host,
+                                           bool ipv6) {
+  struct addrinfo hints{}, *res = nullptr;
+  hints.ai_family = ipv6 ? AF_UNSPEC : AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  std::vector<std::string> v4, v6;
+  if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res)
+    return v4;
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    char ipStr[INET6_ADDRSTRLEN];
+    if (ai->ai_family == AF_INET)
+      inet_ntop(AF_INET, &((struct sockaddr_in *)ai->ai_addr)->sin_addr,
+                ipStr, sizeof(ipStr));
+    else if (ai->ai_family == AF_INET6)
+      inet_ntop(AF_INET6, &((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr,
+                ipStr, sizeof(ipStr));
+    else
+      continue;
+    auto &list = ai->ai_family == AF_INET ? v4 : v6;
+    if (std::find(list.begin(), list.end(), ipStr) == list.end())
+      list.push_back(ipStr);
+  }
+  freeaddrinfo(res);
+  v4.insert(v4.end(), v6.begin(), v6.end());
+  return v4;
+}
+
+// ─────────────────────────────────────────────
+//  Timed Connect
+// ─────────────────────────────────────────────
+// Non-blocking connect of an already created socket with a deadline;
+// elapsedMs receives the time until the outcome was known and *sysErr
+// (when given) the error behind a local Error. The socket stays open.
+inline ConnectStatus connectOn(socket_t sock, const Endpoint &ep,
+                               int timeoutMs, long &elapsedMs,
+                               int *sysErr = nullptr) {
+  elapsedMs = -1;
+  if (!setNonBlocking(sock, true)) {
+    if (sysErr)
+      *sysErr = lastError();
+    return ConnectStatus::Error;
+  }
+
+  auto startTime = std::chrono::steady_clock::now();
+  int rc = connect(sock, ep.sa(), ep.len);
+
+  ConnectStatus status;
+  int err = 0;
+  if (rc == 0) {
+    status = ConnectStatus::Open; // immediate (loopback)
+  } else if (!connectPending(err = lastError())) {
+    status = classifyConnectError(err);
+  } else {
+    int ready = waitWritable(sock, timeoutMs);
+    if (ready > 0)
+      status = classifyPendingError(err = pendingError(sock));
+    else if (ready == 0)
+      status = ConnectStatus::TimedOut;
+    else
+      status = ConnectStatus::Error;
+  }
+
+  auto endTime = std::chrono::steady_clock::now();
+  elapsedMs =
+      (long)std::chrono::duration_cast<std::chrono::milliseconds>(endTime -
+                                                                  startTime)
+          .count();
+  if (sysErr)
+    *sysErr = err;
+  return status;
+}
+
+// connectOn() on a fresh socket. On Open the connected socket is handed
+// to *keepOpen when given (caller closes it), otherwise it is closed.
+inline ConnectStatus connectTimed(const Endpoint &ep, int timeoutMs,
+                                  long &elapsedMs,
+                                  socket_t *keepOpen = nullptr) {
+  elapsedMs = -1;
+  socket_t sock = openTcpSocket(ep.family());
+  if (sock == kInvalidSocket)
+    return ConnectStatus::Error;
+
+  ConnectStatus status = connectOn(sock, ep, timeoutMs, elapsedMs);
+  if (keepOpen && status == ConnectStatus::Open)
+    *keepOpen = sock;
+  else
+    closeSocket(sock);
+  return status;
+}
+
+// ─────────────────────────────────────────────
+//  Misc Platform Helpers
+// ─────────────────────────────────────────────
+inline void localTime(std::time_t t, std::tm &out) {
+#ifdef _WIN32
+  localtime_s(&out, &t);
+#else
+  localtime_r(&t, &out);
+#endif
+}
+
+// User + system CPU time consumed by the whole process, in milliseconds
+inline long long processCpuMs() {
+#ifdef _WIN32
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+    return 0;
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  return (long long)((k.QuadPart + u.QuadPart) / 10000); // 100ns units
+#else
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+  return (long long)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000 +
+         (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+#endif
+}
+
+} // namespace net
@@ -0,0 +1,528 @@
+/*
+ * uring_engine.h - io_uring connect/recv engine (Linux 5.6+)
+ *
+ * Submits IORING_OP_CONNECT linked to an IORING_OP_LINK_TIMEOUT for every
+ * probe and, for open ports, an optional IORING_OP_SEND probe followed by
+ * IORING_OP_RECV (again with a linked timeout) for the banner. SQEs are
+ * queued in batches and pushed with one io_uring_enter() per loop; CQEs
+ * are reaped straight from the shared ring without further syscalls.
+ * A ring that cannot be set up leaves the scan to the others; one whose
+ * io_uring_enter() fails reports what has answered and hands the rest of
+ * its probes back to them.
+ *
+ * Talks to the kernel through the raw io_uring syscalls, so no liburing
+ * is required at build time.
+ */
+#pragma once
+
+#ifdef __linux__
+
+#include "scan_engine.h"
+#include "socket_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <vector>
+
+// ─────────────────────────────────────────────
+//  Minimal io_uring Ring
+// ─────────────────────────────────────────────
+class URing {
+public:
+  URing() = default;
+  URing(const URing &) = delete;
+  URing &operator=(const URing &) = delete;
+
+  ~URing() { close(); }
+
+  // Unmap and close the ring; the kernel cancels what is still in flight
+  void close() {
+    if (sqes_)
+      munmap(sqes_, sqesSize_);
+    if (cqPtr_ && cqPtr_ != sqPtr_)
+      munmap(cqPtr_, cqSize_);
+    if (sqPtr_)
+      munmap(sqPtr_, sqSize_);
+    if (fd_ >= 0)
+      ::close(fd_);
+    sqes_ = nullptr;
+    cqPtr_ = sqPtr_ = nullptr;
+    fd_ = -1;
+  }
+
+  // cqEntries = 0 keeps the kernel default (twice the SQ size)
+  bool init(unsigned entries, unsigned cqEntries = 0) {
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    if (cqEntries) {
+      p.flags |= IORING_SETUP_CQSIZE;
+      p.cq_entries = cqEntries;
+    }
+    fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd_ < 0)
+      return false;
+
+    sqSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+      sqSize_ = cqSize_ = std::max(sqSize_, cqSize_);
+
+    sqPtr_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sqPtr_ == MAP_FAILED) {
+      sqPtr_ = nullptr;
+      return false;
+    }
+    cqPtr_ = single ? sqPtr_
+                    : mmap(nullptr, cqSize_, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cqPtr_ == MAP_FAILED) {
+      cqPtr_ = nullptr;
+      return false;
+    }
+    sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+      return false;
+    sqes_ = (io_uring_sqe *)sqes;
+
+    char *sq = (char *)sqPtr_;
+    sqHead_ = (unsigned *)(sq + p.sq_off.head);
+    sqTail_ = (unsigned *)(sq + p.sq_off.tail);
+    sqMask_ = *(unsigned *)(sq + p.sq_off.ring_mask);
+    sqEntries_ = p.sq_entries;
+    sqArray_ = (unsigned *)(sq + p.sq_off.array);
+    localTail_ = *sqTail_;
+
+    char *cq = (char *)cqPtr_;
+    cqHead_ = (unsigned *)(cq + p.cq_off.head);
+    cqTail_ = (unsigned *)(cq + p.cq_off.tail);
+    cqMask_ = *(unsigned *)(cq + p.cq_off.ring_mask);
+    cqEntries_ = p.cq_entries;
+    cqes_ = (io_uring_cqe *)(cq + p.cq_off.cqes);
+    return true;
+  }
+
+  unsigned cqEntries() const { return cqEntries_; }
+
+  unsigned sqSpace() const {
+    return sqEntries_ - (localTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE));
+  }
+
+  // Next free SQE (zeroed), nullptr when the submission queue is full
+  io_uring_sqe *getSqe() {
+    if (sqSpace() == 0)
+      return nullptr;
+    unsigned idx = localTail_ & sqMask_;
+    io_uring_sqe *sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    localTail_++;
+    return sqe;
+  }
+
+  // Publish queued SQEs and wait for at least waitNr completions
+  int submitAndWait(unsigned waitNr) {
+    unsigned toSubmit = localTail_ - *sqTail_;
+    __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+    int rc;
+    do {
+      rc = (int)syscall(__NR_io_uring_enter, fd_, toSubmit, waitNr,
+                        waitNr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    } while (rc < 0 && errno == EINTR);
+    return rc;
+  }
+
+  // Drain every available CQE without entering the kernel
+  template <class F> unsigned reap(F &&fn) {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    unsigned n = 0;
+    for (; head != tail; head++, n++)
+      fn(cqes_[head & cqMask_]);
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return n;
+  }
+
+private:
+  int fd_ = -1;
+  void *sqPtr_ = nullptr, *cqPtr_ = nullptr;
+  size_t sqSize_ = 0, cqSize_ = 0, sqesSize_ = 0;
+
+  unsigned *sqHead_ = nullptr, *sqTail_ = nullptr, *sqArray_ = nullptr;
+  unsigned sqMask_ = 0, sqEntries_ = 0, localTail_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+
+  unsigned *cqHead_ = nullptr, *cqTail_ = nullptr;
+  unsigned cqMask_ = 0, cqEntries_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+};
+
+// ─────────────────────────────────────────────
+//  io_uring Scan Engine
+// ─────────────────────────────────────────────
+class UringEngine {
+public:
+  explicit UringEngine(const EngineOptions &opts) : opts_(opts) {}
+
+  // Kernel support check (io_uring may be disabled by sysctl/seccomp)
+  static bool available() {
+    URing ring;
+    return ring.init(8);
+  }
+
+  // False when no ring could scan: nothing was reported, or a ring broke
+  // and no healthy one was left to finish the probes it handed back
+  bool run(const ProbeSource &source, const ProbeSink &sink) {
+    int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+    int rings = opts_.reactors > 0 ? opts_.reactors : cores;
+
+    if (!opts_.sockets)
+      opts_.sockets = &ownSockets_;
+
+    int budget = (int)std::min<long>(opts_.maxInFlight,
+                                     opts_.sockets->budget());
+    int perRing = std::max(1, budget / rings);
+
+    // Probes handed back by a broken ring go out again first
+    returned_.clear();
+    ProbeSource next = [this, &source](Probe &p) {
+      {
+        std::lock_guard<std::mutex> lock(returnedMtx_);
+        if (!returned_.empty()) {
+          p = returned_.back();
+          returned_.pop_back();
+          return true;
+        }
+      }
+      return source(p);
+    };
+
+    std::atomic<int> finished(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < rings; i++) {
+      threads.emplace_back([this, i, cores, perRing, &next, &sink,
+                            &finished] {
+        if (opts_.pinThreads) {
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          CPU_SET(i % cores, &set);
+          pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        if (ringLoop(perRing, next, sink) == RingDone)
+          finished++;
+      });
+    }
+    for (auto &t : threads)
+      t.join();
+
+    // A ring that broke after the others had finished left probes behind
+    while (finished > 0 && !returned_.empty())
+      if (ringLoop(perRing, next, sink) != RingDone)
+        return false;
+    return finished > 0;
+  }
+
+private:
+  enum Op : uint64_t {
+    OpConnect,
+    OpConnectTimeout,
+    OpSend,
+    OpRecv,
+    OpRecvTimeout,
+    OpTick // wake-up while the throttle holds back new connects
+  };
+
+  enum Phase { Connecting, Banner };
+
+  enum RingResult {
+    RingDone,   // the source ran dry and every probe was reported
+    RingNoInit, // io_uring could not be set up; nothing was taken
+    RingBroken  // io_uring_enter failed; unanswered probes handed back
+  };
+
+  struct Slot {
+    int fd = -1;
+    Phase phase = Connecting;
+    int pending = 0; // CQEs still owed by the kernel
+    Probe probe;
+    ProbeOutcome out;
+    std::chrono::steady_clock::time_point start;
+    __kernel_timespec connectTs{};
+    __kernel_timespec recvTs{};
+    char buf[512];
+  };
+
+  static uint64_t tag(int slot, Op op) { return ((uint64_t)slot << 8) | op; }
+
+  static __kernel_timespec toTs(int ms) {
+    __kernel_timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long long)(ms % 1000) * 1000000;
+    return ts;
+  }
+
+  void prepConnect(URing &ring, int idx, Slot &s) {
+    io_uring_sqe *sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = s.fd;
+    sqe->addr = (uint64_t)(uintptr_t)s.probe.ep.sa();
+    sqe->off = s.probe.ep.len;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = tag(idx, OpConnect);
+
+    s.connectTs =
+        toTs(s.probe.timeoutMs > 0 ? s.probe.timeoutMs : opts_.timeoutMs);
+    sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&s.connectTs;
+    sqe->len = 1;
+    sqe->user_data = tag(idx, OpConnectTimeout);
+    s.pending = 2;
+  }
+
+  // SQEs needed to start the banner stage for a slot
+  static unsigned bannerSqes(const Slot &s) {
+    return bannerProbe(s.probe.port) ? 3 : 2;
+  }
+
+  void prepBanner(URing &ring, int idx, Slot &s) {
+    s.phase = Banner;
+    s.pending = 0;
+    const char *req = bannerProbe(s.probe.port);
+    if (req) {
+      io_uring_sqe *sqe = ring.getSqe();
+      sqe->opcode = IORING_OP_SEND;
+      sqe->fd = s.fd;
+      sqe->addr = (uint64_t)(uintptr_t)req;
+      sqe->len = (uint32_t)std::strlen(req);
+      sqe->msg_flags = MSG_NOSIGNAL;
+      sqe->flags = IOSQE_IO_LINK;
+      sqe->user_data = tag(idx, OpSend);
+      s.pending++;
+    }
+
+    io_uring_sqe *sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = s.fd;
+    sqe->addr = (uint64_t)(uintptr_t)s.buf;
+    sqe->len = sizeof(s.buf) - 1;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = tag(idx, OpRecv);
+
+    s.recvTs = toTs(opts_.bannerTimeoutMs);
+    sqe = ring.getSqe();
+    sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&s.recvTs;
+    sqe->len = 1;
+    sqe->user_data = tag(idx, OpRecvTimeout);
+    s.pending += 2;
+  }
+
+  RingResult ringLoop(int capacity, const ProbeSource &source,
+                      const ProbeSink &sink) {
+    URing ring;
+    if (!ring.init(4096, 16384))
+      return RingNoInit;
+
+    // Every slot may owe up to three CQEs (plus one throttle tick); never
+    // overflow the CQ ring
+    capacity = std::min(capacity, (int)((ring.cqEntries() - 1) / 3));
+    std::vector<Slot> slots((size_t)capacity);
+    std::vector<int> freeSlots;
+    for (int i = capacity - 1; i >= 0; i--)
+      freeSlots.push_back(i);
+    std::vector<int> bannerQueue; // opened, waiting for SQE space
+
+    int inFlight = 0;
+    bool exhausted = false;
+    Probe pending; // admitted, waiting for a socket
+    bool havePending = false;
+    Throttle *throttle = opts_.throttle;
+    SocketManager &sockets = *opts_.sockets;
+    auto starvedSince = std::chrono::steady_clock::time_point();
+    bool tickArmed = false;
+    __kernel_timespec tickTs = toTs(5);
+
+    auto finish = [&](int idx) {
+      Slot &s = slots[idx];
+      sockets.close(s.fd);
+      s.fd = -1;
+      freeSlots.push_back(idx);
+      inFlight--;
+      sink(s.probe, s.out);
+    };
+
+    // Give up an admitted probe that got no answer: its ticket goes back
+    // and another ring (or run()) scans it
+    auto handBack = [&](const Probe &p) {
+      if (throttle)
+        throttle->cancel(p.ticket);
+      std::lock_guard<std::mutex> lock(returnedMtx_);
+      returned_.push_back(p);
+    };
+
+    // The ring broke mid-scan: report every probe that already has its
+    // connect answer (a banner read so far is kept), hand back the rest
+    auto abandon = [&] {
+      ring.close();
+      for (int idx = 0; idx < capacity; idx++) {
+        Slot &s = slots[(size_t)idx];
+        if (s.fd < 0)
+          continue;
+        if (s.phase == Connecting && s.out.elapsedUs < 0) {
+          sockets.close(s.fd);
+          s.fd = -1;
+          inFlight--;
+          handBack(s.probe);
+          continue;
+        }
+        if (s.phase == Connecting && s.pending > 0 && throttle)
+          throttle->release(s.probe.ticket, s.out);
+        finish(idx);
+      }
+      if (havePending)
+        handBack(pending);
+    };
+
+    auto onCqe = [&](const io_uring_cqe &cqe) {
+      int idx = (int)(cqe.user_data >> 8);
+      Op op = (Op)(cqe.user_data & 0xff);
+      if (op == OpTick) {
+        tickArmed = false;
+        return;
+      }
+      Slot &s = slots[idx];
+
+      if (op == OpConnect) {
+        s.out.elapsedUs = std::chrono::duration_cast<
+                              std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - s.start)
+                              .count();
+        s.out.elapsedMs = (long)(s.out.elapsedUs / 1000);
+        if (cqe.res == -ECANCELED || cqe.res == -ETIME)
+          s.out.status = net::ConnectStatus::TimedOut;
+        else {
+          s.out.status = net::classifyPendingError(-cqe.res);
+          s.out.unreachable = net::unreachableError(-cqe.res);
+        }
+      } else if (op == OpRecv && cqe.res > 0) {
+        s.out.banner.assign(s.buf, (size_t)cqe.res);
+      }
+
+      if (--s.pending > 0)
+        return;
+      if (s.phase == Connecting && throttle)
+        throttle->release(s.probe.ticket, s.out);
+      if (s.phase == Connecting && opts_.grabBanner &&
+          s.out.status == net::ConnectStatus::Open)
+        bannerQueue.push_back(idx);
+      else
+        finish(idx);
+    };
+
+    while (true) {
+      // ── Banner stage for freshly opened ports ──
+      while (!bannerQueue.empty() &&
+             ring.sqSpace() >= bannerSqes(slots[bannerQueue.back()])) {
+        int idx = bannerQueue.back();
+        bannerQueue.pop_back();
+        prepBanner(ring, idx, slots[idx]);
+      }
+
+      // ── Queue a batch of new connects ──
+      bool throttled = false;
+      while (!exhausted && !freeSlots.empty() && ring.sqSpace() >= 3) {
+        int idx = freeSlots.back();
+        Slot &s = slots[idx];
+        if (havePending) {
+          s.probe = pending; // already admitted by the throttle
+          havePending = false;
+        } else {
+          uint64_t ticket = 0;
+          if (throttle && !throttle->tryAcquire(ticket)) {
+            throttled = true;
+            break;
+          }
+          if (!source(s.probe)) {
+            if (throttle)
+              throttle->cancel(ticket);
+            exhausted = true;
+            break;
+          }
+          s.probe.ticket = ticket;
+        }
+        s.out = ProbeOutcome();
+        s.phase = Connecting;
+        int err = 0;
+        s.fd = sockets.open(s.probe.ep, err, false);
+        if (s.fd < 0) {
+          // Out of descriptors or source ports: wait for completions (or
+          // the banner stage) to release sockets, up to kMaxStallMs
+          auto now = std::chrono::steady_clock::now();
+          if (starvedSince == std::chrono::steady_clock::time_point())
+            starvedSince = now;
+          if (SocketManager::isShortage(err) &&
+              now - starvedSince <
+                  std::chrono::milliseconds(SocketManager::kMaxStallMs)) {
+            pending = s.probe;
+            havePending = true;
+            throttled = true; // re-check after a tick
+            break;
+          }
+          starvedSince = std::chrono::steady_clock::time_point();
+          s.out.status = net::ConnectStatus::Error;
+          if (throttle)
+            throttle->release(s.probe.ticket, s.out);
+          sink(s.probe, s.out);
+          continue;
+        }
+        starvedSince = std::chrono::steady_clock::time_point();
+        freeSlots.pop_back();
+        s.start = std::chrono::steady_clock::now();
+        prepConnect(ring, idx, s);
+        inFlight++;
+      }
+
+      if (inFlight == 0 && exhausted && !havePending)
+        break;
+
+      // Nothing else may complete soon enough to re-check the throttle
+      if (throttled && !tickArmed) {
+        io_uring_sqe *sqe = ring.getSqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)(uintptr_t)&tickTs;
+        sqe->len = 1;
+        sqe->user_data = tag(0, OpTick);
+        tickArmed = true;
+      }
+
+      // ── One syscall: submit the batch, wait for completions ──
+      int rc = ring.submitAndWait(1);
+      if (rc < 0 && errno != EBUSY && errno != EAGAIN) {
+        abandon();
+        return RingBroken;
+      }
+      ring.reap(onCqe);
+    }
+    return RingDone;
+  }
+
+  EngineOptions opts_;
+  SocketManager ownSockets_; // when the caller brings none
+  std::mutex returnedMtx_;
+  std::vector<Probe> returned_; // handed back by a broken ring
+};
+
+#endif // __linux__